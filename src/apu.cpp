@@ -4,28 +4,559 @@
 
 #include "apu.h"
 #include "cpu.h"
+#include "memory_arena.h"
+#include "audio/sample_buffer.h"
+#include "capture/audio_capture.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 namespace APU {
+namespace {
 
-Registers registers{};
+constexpr uint8_t kDutyPatterns[4]{0b00000001, 0b10000001, 0b10000111, 0b01111110};
+constexpr int kNoiseDivisors[8]{8, 16, 32, 48, 64, 80, 96, 112};
 
-uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
-  switch (addr) {
-    case 0xFF11:
-      if (m == CPU::read) {
-        return 0xFF;
+// Bits of 0xFF10-0xFF2F that always read back as 1.
+constexpr uint8_t kReadMasks[0x20]{
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,  // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,  // unused, NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,  // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,  // unused, NR41-NR44
+    0x00, 0x00, 0x70, 0xFF,        // NR50-NR52, unused
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+// Sample value of one step of a channel at master volume 1. Four channels
+// at full volume on both sides stay just inside 16 bits.
+constexpr int kLevelScale = 64;
+// A quarter second of samples is kept for a reader that falls behind.
+constexpr int kBufferFrames = kSampleRate / 4;
+
+uint8_t *const wave_ram = Memory::arena.wave_ram;
+
+// Last value written to every register, read back through kReadMasks.
+uint8_t registers[0x20];
+bool power = false;
+Square square1;
+Square square2;
+Sweep sweep;
+Wave wave;
+Noise noise;
+// Clock everything above has been run up to.
+uint64_t apu_clock = 0;
+uint64_t next_sequencer_step = kSequencerCycles;
+int sequencer_step = 0;
+SampleBuffer buffer(kClockRate, kSampleRate, kBufferFrames);
+// A second buffer fed the same steps while the mix is being recorded, at the
+// nominal rate whatever rate control does to buffer.
+SampleBuffer recording_buffer(kClockRate, kSampleRate, kBufferFrames);
+bool recording = false;
+
+uint8_t &Register(uint16_t addr) {
+  return registers[addr - 0xFF10];
+}
+
+// Recompute what channel index adds to the mix from its digital output,
+// panning and the master volume, and step the buffer by the difference.
+void UpdateLevel(Channel &channel, int index, uint64_t time) {
+  uint8_t panning = Register(0xFF25);
+  uint8_t master = Register(0xFF24);
+  int digital = channel.enabled && channel.dac ? channel.digital : 0;
+  int left = (panning >> (4 + index)) & 1 ? digital * (((master >> 4) & 7) + 1) * kLevelScale : 0;
+  int right = (panning >> index) & 1 ? digital * ((master & 7) + 1) * kLevelScale : 0;
+  if (left != channel.left || right != channel.right) {
+    buffer.AddDelta(time, left - channel.left, right - channel.right);
+    if (recording) {
+      recording_buffer.AddDelta(time, left - channel.left, right - channel.right);
+    }
+    channel.left = left;
+    channel.right = right;
+  }
+}
+
+void UpdateAllLevels() {
+  UpdateLevel(square1.channel, 0, apu_clock);
+  UpdateLevel(square2.channel, 1, apu_clock);
+  UpdateLevel(wave.channel, 2, apu_clock);
+  UpdateLevel(noise.channel, 3, apu_clock);
+}
+
+int SquarePeriod(const Square &square) {
+  return (2048 - square.channel.frequency) * 4;
+}
+
+int WavePeriod() {
+  return (2048 - wave.channel.frequency) * 2;
+}
+
+int NoisePeriod() {
+  return kNoiseDivisors[noise.divisor] << noise.shift;
+}
+
+int SquareOutput(const Square &square) {
+  return (kDutyPatterns[square.duty] >> square.duty_step) & 1 ? square.envelope.volume : 0;
+}
+
+int WaveOutput() {
+  if (wave.volume == 0) {
+    return 0;
+  }
+  uint8_t sample = wave_ram[wave.position / 2];
+  sample = wave.position % 2 ? sample & 0xF : sample >> 4;
+  return sample >> (wave.volume - 1);
+}
+
+int NoiseOutput() {
+  return noise.lfsr & 1 ? 0 : noise.envelope.volume;
+}
+
+/* Waveform generation, every step before end at the clock it happens */
+
+void RunSquare(Square &square, int index, uint64_t end) {
+  Channel &channel = square.channel;
+  if (!channel.enabled) {
+    return;
+  }
+  if (square.envelope.volume == 0) {
+    // every step outputs 0 until the sequencer changes the volume, which
+    // only happens between calls. Skip them in one go, keeping the duty
+    // position.
+    if (channel.next_step < end) {
+      uint64_t period = SquarePeriod(square);
+      uint64_t steps = (end - channel.next_step + period - 1) / period;
+      square.duty_step = (square.duty_step + steps) % 8;
+      channel.next_step += steps * period;
+    }
+    return;
+  }
+  while (channel.next_step < end) {
+    square.duty_step = (square.duty_step + 1) % 8;
+    channel.digital = SquareOutput(square);
+    UpdateLevel(channel, index, channel.next_step);
+    channel.next_step += SquarePeriod(square);
+  }
+}
+
+void RunWave(uint64_t end) {
+  Channel &channel = wave.channel;
+  if (!channel.enabled) {
+    return;
+  }
+  while (channel.next_step < end) {
+    wave.position = (wave.position + 1) % 32;
+    channel.digital = WaveOutput();
+    UpdateLevel(channel, 2, channel.next_step);
+    channel.next_step += WavePeriod();
+  }
+}
+
+void RunNoise(uint64_t end) {
+  Channel &channel = noise.channel;
+  if (!channel.enabled) {
+    return;
+  }
+  while (channel.next_step < end) {
+    // the LFSR gets no clocks at all with the two largest shifts.
+    if (noise.shift < 14) {
+      int feedback = (noise.lfsr ^ (noise.lfsr >> 1)) & 1;
+      noise.lfsr = (noise.lfsr >> 1) | (feedback << 14);
+      if (noise.short_mode) {
+        noise.lfsr = (noise.lfsr & ~(1 << 6)) | (feedback << 6);
       }
-      registers.NR11 = val;
-      return registers.NR11;
-    case 0xFF16:
-      if (m == CPU::read) {
-        return 0xFF;
+    }
+    channel.digital = NoiseOutput();
+    UpdateLevel(channel, 3, channel.next_step);
+    channel.next_step += NoisePeriod();
+  }
+}
+
+/* Frame sequencer units */
+
+void ClockLength(Channel &channel, int index) {
+  if (channel.length_enabled && channel.length > 0 && --channel.length == 0) {
+    channel.enabled = false;
+    UpdateLevel(channel, index, apu_clock);
+  }
+}
+
+// Period 0 stands for 8 in the timers of the envelopes and the sweep.
+bool CountDown(uint8_t &timer, uint8_t period) {
+  if (timer > 1) {
+    --timer;
+    return false;
+  }
+  timer = period ? period : 8;
+  return true;
+}
+
+void ClockEnvelope(Envelope &envelope) {
+  if (!CountDown(envelope.timer, envelope.period) || envelope.period == 0) {
+    return;
+  }
+  if (envelope.increase && envelope.volume < 15) {
+    ++envelope.volume;
+  } else if (!envelope.increase && envelope.volume > 0) {
+    --envelope.volume;
+  }
+}
+
+// Next frequency of the sweep, disabling channel 1 when it overflows.
+int SweepFrequency() {
+  int delta = sweep.shadow_frequency >> sweep.shift;
+  int frequency = sweep.negate ? sweep.shadow_frequency - delta : sweep.shadow_frequency + delta;
+  if (frequency > 2047) {
+    square1.channel.enabled = false;
+    UpdateLevel(square1.channel, 0, apu_clock);
+  }
+  return frequency;
+}
+
+void ClockSweep() {
+  if (!CountDown(sweep.timer, sweep.period) || !sweep.enabled || sweep.period == 0) {
+    return;
+  }
+  int frequency = SweepFrequency();
+  if (frequency <= 2047 && sweep.shift != 0) {
+    sweep.shadow_frequency = frequency;
+    square1.channel.frequency = frequency;
+    SweepFrequency();
+  }
+}
+
+// 512 Hz: length on even steps, sweep on 2 and 6, envelopes on 7.
+void StepSequencer() {
+  if (sequencer_step % 2 == 0) {
+    ClockLength(square1.channel, 0);
+    ClockLength(square2.channel, 1);
+    ClockLength(wave.channel, 2);
+    ClockLength(noise.channel, 3);
+  }
+  if (sequencer_step == 2 || sequencer_step == 6) {
+    ClockSweep();
+  }
+  if (sequencer_step == 7) {
+    ClockEnvelope(square1.envelope);
+    ClockEnvelope(square2.envelope);
+    ClockEnvelope(noise.envelope);
+    square1.channel.digital = SquareOutput(square1);
+    square2.channel.digital = SquareOutput(square2);
+    noise.channel.digital = NoiseOutput();
+    UpdateAllLevels();
+  }
+  sequencer_step = (sequencer_step + 1) % 8;
+}
+
+// Complete the samples up to apu_clock, and hand the recorded ones over.
+void EndFrame() {
+  buffer.EndFrame(apu_clock);
+  if (recording) {
+    recording_buffer.EndFrame(apu_clock);
+    int16_t samples[SampleBuffer::kMaxFrameSamples * 2];
+    int frames = recording_buffer.ReadSamples(samples, SampleBuffer::kMaxFrameSamples);
+    Capture::SubmitAudio(Capture::mixer_audio, samples, frames);
+  }
+}
+
+// Run every channel up to target, a stretch between frame sequencer steps
+// at a time. The buffer gets its samples completed at every step.
+void RunUntil(uint64_t target) {
+  while (apu_clock < target) {
+    uint64_t end = std::min(target, next_sequencer_step);
+    RunSquare(square1, 0, end);
+    RunSquare(square2, 1, end);
+    RunWave(end);
+    RunNoise(end);
+    apu_clock = end;
+    if (apu_clock == next_sequencer_step) {
+      if (power) {
+        StepSequencer();
+      }
+      next_sequencer_step += kSequencerCycles;
+      EndFrame();
+    }
+  }
+}
+
+void CatchUp() {
+  bool record = Capture::IsCapturingAudio(Capture::mixer_audio);
+  if (record && !recording) {
+    recording_buffer.Reset(apu_clock);
+  }
+  recording = record;
+  RunUntil(CPU::Clock());
+}
+
+/* Register writes */
+
+void WriteEnvelope(Envelope &envelope, Channel &channel, uint8_t val) {
+  envelope.initial_volume = val >> 4;
+  envelope.increase = val & 0x08;
+  envelope.period = val & 0x07;
+  // the DAC is off when the top 5 bits are clear, which also stops the channel.
+  channel.dac = (val & 0xF8) != 0;
+  if (!channel.dac) {
+    channel.enabled = false;
+  }
+}
+
+void TriggerChannel(Channel &channel, int full_length, int period) {
+  channel.enabled = channel.dac;
+  if (channel.length == 0) {
+    channel.length = full_length;
+  }
+  channel.next_step = apu_clock + period;
+}
+
+void TriggerEnvelope(Envelope &envelope) {
+  envelope.volume = envelope.initial_volume;
+  envelope.timer = envelope.period ? envelope.period : 8;
+}
+
+// Write to the frequency high byte and control register of a channel,
+// returns whether it triggers.
+bool WriteControl(Channel &channel, uint8_t val) {
+  channel.frequency = (channel.frequency & 0xFF) | ((val & 0x07) << 8);
+  channel.length_enabled = val & 0x40;
+  return val & 0x80;
+}
+
+void WriteSquare(Square &square, int index, int reg, uint8_t val) {
+  Channel &channel = square.channel;
+  switch (reg) {
+    case 1:
+      square.duty = val >> 6;
+      channel.length = 64 - (val & 0x3F);
+      break;
+    case 2:
+      WriteEnvelope(square.envelope, channel, val);
+      break;
+    case 3:
+      channel.frequency = (channel.frequency & 0x700) | val;
+      break;
+    case 4:
+      if (WriteControl(channel, val)) {
+        TriggerChannel(channel, 64, SquarePeriod(square));
+        TriggerEnvelope(square.envelope);
+        if (index == 0) {
+          sweep.shadow_frequency = channel.frequency;
+          sweep.timer = sweep.period ? sweep.period : 8;
+          sweep.enabled = sweep.period != 0 || sweep.shift != 0;
+          if (sweep.shift != 0) {
+            SweepFrequency();
+          }
+        }
       }
-      registers.NR21 = val;
-      return registers.NR11;
+      break;
   }
-  return 0;
+  channel.digital = SquareOutput(square);
+  UpdateLevel(channel, index, apu_clock);
+}
+
+void WriteWave(int reg, uint8_t val) {
+  Channel &channel = wave.channel;
+  switch (reg) {
+    case 0:
+      channel.dac = val & 0x80;
+      if (!channel.dac) {
+        channel.enabled = false;
+      }
+      break;
+    case 1:
+      channel.length = 256 - val;
+      break;
+    case 2:
+      wave.volume = (val >> 5) & 3;
+      break;
+    case 3:
+      channel.frequency = (channel.frequency & 0x700) | val;
+      break;
+    case 4:
+      if (WriteControl(channel, val)) {
+        TriggerChannel(channel, 256, WavePeriod());
+        wave.position = 0;
+      }
+      break;
+  }
+  channel.digital = WaveOutput();
+  UpdateLevel(channel, 2, apu_clock);
+}
+
+void WriteNoise(int reg, uint8_t val) {
+  Channel &channel = noise.channel;
+  switch (reg) {
+    case 1:
+      channel.length = 64 - (val & 0x3F);
+      break;
+    case 2:
+      WriteEnvelope(noise.envelope, channel, val);
+      break;
+    case 3:
+      noise.shift = val >> 4;
+      noise.short_mode = val & 0x08;
+      noise.divisor = val & 0x07;
+      break;
+    case 4:
+      channel.length_enabled = val & 0x40;
+      if (val & 0x80) {
+        TriggerChannel(channel, 64, NoisePeriod());
+        TriggerEnvelope(noise.envelope);
+        noise.lfsr = 0x7FFF;
+      }
+      break;
+  }
+  channel.digital = NoiseOutput();
+  UpdateLevel(channel, 3, apu_clock);
+}
+
+// Powering off clears every register and stops all channels, powering on
+// restarts the frame sequencer.
+void SetPower(bool on) {
+  if (power == on) {
+    return;
+  }
+  power = on;
+  if (!on) {
+    square1.channel.enabled = false;
+    square2.channel.enabled = false;
+    wave.channel.enabled = false;
+    noise.channel.enabled = false;
+    UpdateAllLevels();
+    // every level is 0 now, so the channels can start over from scratch.
+    square1 = {};
+    square2 = {};
+    sweep = {};
+    wave = {};
+    noise = {};
+    memset(registers, 0, 0x16);
+  } else {
+    sequencer_step = 0;
+    next_sequencer_step = apu_clock + kSequencerCycles;
+  }
+}
+
+uint8_t ReadStatus() {
+  return (power ? 0x80 : 0) | kReadMasks[0x16] | (square1.channel.enabled ? 1 : 0)
+      | (square2.channel.enabled ? 2 : 0) | (wave.channel.enabled ? 4 : 0) | (noise.channel.enabled ? 8 : 0);
+}
+
+}  // namespace
+
+uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
+  CatchUp();
+  if (addr >= 0xFF30) {
+    if (m == CPU::write) {
+      wave_ram[addr - 0xFF30] = val;
+    }
+    return wave_ram[addr - 0xFF30];
+  }
+  if (m == CPU::read) {
+    return addr == 0xFF26 ? ReadStatus() : Register(addr) | kReadMasks[addr - 0xFF10];
+  }
+  if (addr == 0xFF26) {
+    SetPower(val & 0x80);
+    return ReadStatus();
+  }
+  // only NR52 can be written while the APU is off.
+  if (!power || addr > 0xFF26) {
+    return 0xFF;
+  }
+  Register(addr) = val;
+  if (addr <= 0xFF14) {
+    if (addr == 0xFF10) {
+      sweep.period = (val >> 4) & 7;
+      sweep.negate = val & 0x08;
+      sweep.shift = val & 0x07;
+    } else {
+      WriteSquare(square1, 0, addr - 0xFF10, val);
+    }
+  } else if (addr <= 0xFF19) {
+    WriteSquare(square2, 1, addr - 0xFF15, val);
+  } else if (addr <= 0xFF1E) {
+    WriteWave(addr - 0xFF1A, val);
+  } else if (addr <= 0xFF23) {
+    WriteNoise(addr - 0xFF1F, val);
+  } else {
+    // master volume or panning.
+    UpdateAllLevels();
+  }
+  return val;
+}
+
+void Reset() {
+  square1 = {};
+  square2 = {};
+  sweep = {};
+  wave = {};
+  noise = {};
+  memset(registers, 0, sizeof(registers));
+  power = false;
+  apu_clock = CPU::Clock();
+  buffer.Reset(apu_clock);
+  recording_buffer.Reset(apu_clock);
+  constexpr uint8_t kBootValues[]{
+      0x80, 0xBF, 0xF3, 0xFF, 0x3F,  // NR10-NR14, without triggering
+      0xFF, 0x3F, 0x00, 0xFF, 0x3F,
+      0x7F, 0xFF, 0x9F, 0xFF, 0x3F,
+      0xFF, 0xFF, 0x00, 0x00, 0x3F,
+      0x77, 0xF3,
+  };
+  access_registers(CPU::write, 0xFF26, 0x80);
+  for (int i = 0; i < static_cast<int>(sizeof(kBootValues)); ++i) {
+    access_registers(CPU::write, 0xFF10 + i, kBootValues[i]);
+  }
+  // the boot sound has faded out, but channel 1 still reads as on. Silent,
+  // it costs nothing to run from here on.
+  square1.channel.enabled = true;
+  square1.channel.next_step = apu_clock;
+}
+
+void SaveState(State *out) {
+  CatchUp();
+  memcpy(out->registers, registers, sizeof(registers));
+  out->power = power;
+  out->square1 = square1;
+  out->square2 = square2;
+  out->sweep = sweep;
+  out->wave = wave;
+  out->noise = noise;
+  out->apu_clock = apu_clock;
+  out->next_sequencer_step = next_sequencer_step;
+  out->sequencer_step = sequencer_step;
+}
+
+void LoadState(const State &in) {
+  CatchUp();
+  // what each channel adds to the mix right now, the restored levels are
+  // stepped to from there.
+  Channel playing[4]{square1.channel, square2.channel, wave.channel, noise.channel};
+  memcpy(registers, in.registers, sizeof(registers));
+  power = in.power;
+  square1 = in.square1;
+  square2 = in.square2;
+  sweep = in.sweep;
+  wave = in.wave;
+  noise = in.noise;
+  // the clock kept running since the save, move every step time with it.
+  Channel *channels[4]{&square1.channel, &square2.channel, &wave.channel, &noise.channel};
+  for (int i = 0; i < 4; ++i) {
+    channels[i]->next_step = channels[i]->next_step - in.apu_clock + apu_clock;
+    channels[i]->left = playing[i].left;
+    channels[i]->right = playing[i].right;
+  }
+  next_sequencer_step = in.next_sequencer_step - in.apu_clock + apu_clock;
+  sequencer_step = in.sequencer_step;
+  UpdateAllLevels();
+}
+
+int ReadSamples(int16_t *out, int max_frames) {
+  CatchUp();
+  EndFrame();
+  return buffer.ReadSamples(out, max_frames);
+}
+
+void SetRateAdjust(double adjust) {
+  buffer.SetRateAdjust(adjust);
 }
 
-}  // namespace APU
\ No newline at end of file
+}  // namespace APU
@@ -8,15 +8,111 @@
 #include <stdint.h>
 #include "cpu.h"
 
+// The four sound channels, synthesized lazily: the APU only catches up to
+// CPU::Clock() when one of its registers is accessed or samples are read,
+// and never runs from CPU::Tick.
 namespace APU {
 
-struct Registers {
- uint8_t NR11;
- uint8_t NR21;
+// The normal speed clock the APU runs on, in T-cycles per second.
+constexpr int kClockRate = 4194304;
+constexpr int kSampleRate = 48000;
+// The frame sequencer steps at 512 Hz.
+constexpr int kSequencerCycles = kClockRate / 512;
+
+struct Envelope {
+  uint8_t initial_volume;
+  bool increase;
+  uint8_t period;
+  uint8_t volume;
+  uint8_t timer;
+};
+
+struct Channel {
+  bool enabled;
+  bool dac;
+  // Steps left before the channel turns itself off, when length_enabled.
+  int length;
+  bool length_enabled;
+  uint16_t frequency;
+  // Clock of the next step of the waveform.
+  uint64_t next_step;
+  // Output of the channel, 0 to 15.
+  int digital;
+  // What the channel adds to each side of the mix right now.
+  int left;
+  int right;
+};
+
+struct Square {
+  Channel channel;
+  Envelope envelope;
+  uint8_t duty;
+  uint8_t duty_step;
+};
+
+// Channel 1 only.
+struct Sweep {
+  uint8_t period;
+  bool negate;
+  uint8_t shift;
+  uint8_t timer;
+  bool enabled;
+  uint16_t shadow_frequency;
+};
+
+struct Wave {
+  Channel channel;
+  // 0 mutes, otherwise the sample is shifted right by volume - 1.
+  uint8_t volume;
+  uint8_t position;
+};
+
+struct Noise {
+  Channel channel;
+  Envelope envelope;
+  uint8_t shift;
+  bool short_mode;
+  uint8_t divisor;
+  uint16_t lfsr;
+};
+
+// Everything the channels keep between register writes, for save states.
+// Wave RAM is not in here, it lives in the arena.
+struct State {
+  // Last value written to every register.
+  uint8_t registers[0x20];
+  bool power;
+  Square square1;
+  Square square2;
+  Sweep sweep;
+  Wave wave;
+  Noise noise;
+  // Clock the state was saved at, the step times above count from it.
+  uint64_t apu_clock;
+  uint64_t next_sequencer_step;
+  int sequencer_step;
 };
 
 uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val);
 
+void SaveState(State* out);
+// Restore a saved state at the current clock, the mix steps from what was
+// playing to the restored levels. Call it before the arena is restored, the
+// wave channel reads wave RAM as it catches up to the load.
+void LoadState(const State& in);
+
+// Registers as the boot ROM leaves them, called with the rest of the power
+// up sequence.
+void Reset();
+
+// Catch up to the current clock and move up to max_frames interleaved
+// left/right samples to out. Returns how many frames were written.
+int ReadSamples(int16_t* out, int max_frames);
+
+// Make 1 + adjust times the nominal samples per second from the next read
+// on, see RateControl.
+void SetRateAdjust(double adjust);
+
 }
 
 #endif //GB_EMU_SRC_APU_H_
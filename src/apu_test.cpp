@@ -0,0 +1,134 @@
+//
+// Created by Brian Bonafilia on 1/5/25.
+//
+
+#include "apu.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <gtest/gtest.h>
+#include "cpu.h"
+#include "capture/audio_capture.h"
+
+namespace APU {
+namespace {
+
+uint8_t Read(uint16_t addr) {
+  return CPU::access<CPU::read>(addr);
+}
+
+void Write(uint16_t addr, uint8_t val) {
+  CPU::access<CPU::write>(addr, val);
+}
+
+// Let the CPU clock run, the APU only notices on its next access.
+void RunCycles(int t_cycles) {
+  for (int i = 0; i < t_cycles / 4; ++i) {
+    CPU::Tick();
+  }
+}
+
+TEST(Apu, BootState) {
+  CPU::InitializeRegisters(false);
+  EXPECT_EQ(Read(0xFF26), 0xF1);
+  EXPECT_EQ(Read(0xFF11), 0xBF);
+  EXPECT_EQ(Read(0xFF24), 0x77);
+  EXPECT_EQ(Read(0xFF25), 0xF3);
+  // write only registers read as all ones.
+  EXPECT_EQ(Read(0xFF13), 0xFF);
+}
+
+TEST(Apu, LengthTurnsChannelOff) {
+  CPU::InitializeRegisters(false);
+  Write(0xFF16, 0x3D);  // 3 length steps
+  Write(0xFF17, 0xF0);
+  Write(0xFF19, 0xC0);  // trigger with length enabled
+  EXPECT_EQ(Read(0xFF26) & 0x2, 0x2);
+  // length is clocked on every other sequencer step.
+  RunCycles(3 * kSequencerCycles);
+  EXPECT_EQ(Read(0xFF26) & 0x2, 0x2);
+  RunCycles(4 * kSequencerCycles);
+  EXPECT_EQ(Read(0xFF26) & 0x2, 0);
+}
+
+TEST(Apu, SweepOverflowDisablesChannel) {
+  CPU::InitializeRegisters(false);
+  Write(0xFF10, 0x01);  // add the frequency shifted right by 1
+  Write(0xFF12, 0xF0);
+  Write(0xFF13, 1500 & 0xFF);
+  Write(0xFF14, 0x80 | (1500 >> 8));
+  EXPECT_EQ(Read(0xFF26) & 0x1, 0);
+}
+
+TEST(Apu, PowerOffClearsRegisters) {
+  CPU::InitializeRegisters(false);
+  Write(0xFF26, 0x00);
+  EXPECT_EQ(Read(0xFF26), 0x70);
+  EXPECT_EQ(Read(0xFF24), 0x00);
+  // ignored while off.
+  Write(0xFF24, 0x77);
+  EXPECT_EQ(Read(0xFF24), 0x00);
+  Write(0xFF26, 0x80);
+  Write(0xFF24, 0x77);
+  EXPECT_EQ(Read(0xFF24), 0x77);
+}
+
+TEST(Apu, SquareWavePitch) {
+  CPU::InitializeRegisters(false);
+  // 131072 / (2048 - 1792) = 512 Hz at 50% duty.
+  Write(0xFF16, 0x80);
+  Write(0xFF17, 0xF0);
+  Write(0xFF18, 1792 & 0xFF);
+  Write(0xFF19, 0x80 | (1792 >> 8));
+  // give the DC blocker a moment to center the wave first.
+  RunCycles(kClockRate / 5);
+  std::vector<int16_t> drop(kSampleRate * 2);
+  ReadSamples(drop.data(), kSampleRate);
+  RunCycles(kClockRate / 10);
+  std::vector<int16_t> samples(kSampleRate / 10 * 2 + 64);
+  int frames = ReadSamples(samples.data(), kSampleRate / 10 + 32);
+  EXPECT_NEAR(frames, kSampleRate / 10, 2);
+  int rising_edges = 0;
+  bool high = samples[0] > 0;
+  for (int i = 1; i < frames; ++i) {
+    int16_t left = samples[i * 2];
+    if (!high && left > 1000) {
+      high = true;
+      ++rising_edges;
+    } else if (high && left < -1000) {
+      high = false;
+    }
+  }
+  EXPECT_NEAR(rising_edges, 51, 1);
+}
+
+TEST(Apu, MixerCaptureMatchesTheOutput) {
+  constexpr char kPath[] = "apu_test_mixer.wav";
+  ASSERT_TRUE(Capture::StartAudio(kPath, Capture::mixer_audio, Capture::block_until_written));
+  CPU::InitializeRegisters(false);
+  Write(0xFF16, 0x80);
+  Write(0xFF17, 0xF0);
+  Write(0xFF18, 1792 & 0xFF);
+  Write(0xFF19, 0x80 | (1792 >> 8));
+  RunCycles(kClockRate / 10);
+  std::vector<int16_t> samples(kSampleRate / 10 * 2 + 64);
+  int frames = ReadSamples(samples.data(), kSampleRate / 10 + 32);
+  Capture::StopAudio();
+
+  std::ifstream in(kPath, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::remove(kPath);
+  // without rate control both buffers make the same samples.
+  ASSERT_EQ(bytes.size(), 44u + frames * 4);
+  std::vector<int16_t> recorded(frames * 2);
+  for (int i = 0; i < frames * 2; ++i) {
+    recorded[i] = static_cast<int16_t>(static_cast<uint8_t>(bytes[44 + i * 2]) | bytes[45 + i * 2] << 8);
+  }
+  samples.resize(frames * 2);
+  EXPECT_EQ(recorded, samples);
+}
+
+}  // namespace
+}  // namespace APU
@@ -0,0 +1,73 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#ifndef GB_EMU_SRC_AUDIO_AUDIO_RING_H_
+#define GB_EMU_SRC_AUDIO_AUDIO_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace APU {
+
+// Lock-free ring of interleaved stereo 16 bit frames between the emulation
+// thread, which writes, and the audio callback, which reads. It counts in
+// frames, so a partial write or read never splits the two samples of one.
+// kFrames must be a power of two.
+template <size_t kFrames>
+class AudioRing {
+  static_assert((kFrames & (kFrames - 1)) == 0, "capacity must be a power of two");
+
+ public:
+  // Copy up to frames frames from in, returns how many fit. Never blocks.
+  int Write(const int16_t* in, int frames) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(frames, kFrames - (tail - head));
+    size_t start = tail & kMask;
+    size_t first = std::min(count, kFrames - start);
+    std::copy(in, in + first * 2, samples_ + start * 2);
+    std::copy(in + first * 2, in + count * 2, samples_);
+    tail_.store(tail + count, std::memory_order_release);
+    return static_cast<int>(count);
+  }
+
+  // Move up to frames frames to out, returns how many there were. Never
+  // blocks.
+  int Read(int16_t* out, int frames) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(frames, tail - head);
+    size_t start = head & kMask;
+    size_t first = std::min(count, kFrames - start);
+    std::copy(samples_ + start * 2, samples_ + (start + first) * 2, out);
+    std::copy(samples_, samples_ + (count - first) * 2, out + first * 2);
+    head_.store(head + count, std::memory_order_release);
+    return static_cast<int>(count);
+  }
+
+  // Frames queued, exact only from the producer or the consumer while the
+  // other side is idle.
+  int Frames() const {
+    return static_cast<int>(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire));
+  }
+
+  static constexpr int Capacity() {
+    return static_cast<int>(kFrames);
+  }
+
+ private:
+  static constexpr size_t kMask = kFrames - 1;
+
+  // Consumer side.
+  alignas(64) std::atomic<size_t> head_{0};
+  // Producer side.
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) int16_t samples_[kFrames * 2];
+};
+
+}  // namespace APU
+
+#endif //GB_EMU_SRC_AUDIO_AUDIO_RING_H_
@@ -0,0 +1,70 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#include "audio_ring.h"
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace APU {
+namespace {
+
+// Written at a time by the producer, not a divisor of the capacity.
+constexpr int kBlock = 301;
+
+std::vector<int16_t> Frames(int first, int count) {
+  std::vector<int16_t> samples;
+  for (int i = first; i < first + count; ++i) {
+    samples.push_back(i);
+    samples.push_back(-i);
+  }
+  return samples;
+}
+
+TEST(AudioRing, WrapsAroundTheEnd) {
+  AudioRing<8> ring;
+  std::vector<int16_t> out(16);
+  EXPECT_EQ(ring.Write(Frames(0, 6).data(), 6), 6);
+  EXPECT_EQ(ring.Read(out.data(), 4), 4);
+  // 2 queued, 6 free of which 2 fit before the end.
+  EXPECT_EQ(ring.Write(Frames(6, 10).data(), 10), 6);
+  EXPECT_EQ(ring.Frames(), 8);
+  EXPECT_EQ(ring.Write(Frames(12, 1).data(), 1), 0);
+  out.assign(16, 0);
+  EXPECT_EQ(ring.Read(out.data(), 8), 8);
+  EXPECT_EQ(out, Frames(4, 8));
+  EXPECT_EQ(ring.Read(out.data(), 8), 0);
+}
+
+TEST(AudioRing, ConcurrentInOrder) {
+  constexpr int kFrames = 100'000;
+  AudioRing<1024> ring;
+  std::thread producer([&ring] {
+    for (int i = 0; i < kFrames;) {
+      std::vector<int16_t> block = Frames(i, std::min(kBlock, kFrames - i));
+      int written = ring.Write(block.data(), block.size() / 2);
+      if (written == 0) {
+        std::this_thread::yield();
+      }
+      i += written;
+    }
+  });
+  std::vector<int16_t> out(512 * 2);
+  for (int expected = 0; expected < kFrames;) {
+    int read = ring.Read(out.data(), 512);
+    if (read == 0) {
+      // let the producer run when both share a core.
+      std::this_thread::yield();
+    }
+    for (int i = 0; i < read; ++i, ++expected) {
+      ASSERT_EQ(out[i * 2], static_cast<int16_t>(expected));
+      ASSERT_EQ(out[i * 2 + 1], static_cast<int16_t>(-expected));
+    }
+  }
+  producer.join();
+}
+
+}  // namespace
+}  // namespace APU
@@ -0,0 +1,28 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#include "rate_control.h"
+
+#include <algorithm>
+
+namespace APU {
+
+namespace {
+
+// Weight of the newest fill in the running average, about 8 frames.
+constexpr double kSmoothing = 0.125;
+
+}  // namespace
+
+RateControl::RateControl(int target_frames, double max_adjust)
+    : target_(target_frames), max_adjust_(max_adjust), average_(target_frames) {}
+
+double RateControl::Update(int queued_frames) {
+  average_ += (queued_frames - average_) * kSmoothing;
+  // full adjustment at an empty ring or at twice the target.
+  double error = (target_ - average_) / target_;
+  return std::clamp(error * max_adjust_, -max_adjust_, max_adjust_);
+}
+
+}  // namespace APU
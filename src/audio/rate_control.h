@@ -0,0 +1,37 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#ifndef GB_EMU_SRC_AUDIO_RATE_CONTROL_H_
+#define GB_EMU_SRC_AUDIO_RATE_CONTROL_H_
+
+// Dynamic rate control: the emulated clock and the audio device's clock never
+// agree exactly, so the output ring would slowly drain or fill up. Stretching
+// the resampling ratio by a fraction of a percent, far below what can be
+// heard, keeps the ring near its target fill instead.
+namespace APU {
+
+class RateControl {
+ public:
+  // target_frames is the ring fill to hold, max_adjust the largest change of
+  // the ratio either way.
+  explicit RateControl(int target_frames, double max_adjust = kMaxAdjust);
+
+  // Take the ring fill seen after queueing a frame's samples, returns the
+  // adjustment of the ratio to use next, within +-max_adjust. Positive means
+  // make more samples.
+  double Update(int queued_frames);
+
+  static constexpr double kMaxAdjust = 0.005;
+
+ private:
+  const double target_;
+  const double max_adjust_;
+  // The fill jumps by a whole callback period whenever the device reads, so
+  // it is averaged over several frames before it steers.
+  double average_;
+};
+
+}  // namespace APU
+
+#endif //GB_EMU_SRC_AUDIO_RATE_CONTROL_H_
@@ -0,0 +1,40 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#include "rate_control.h"
+
+#include <gtest/gtest.h>
+
+namespace APU {
+namespace {
+
+TEST(RateControl, SteersTowardsTheTarget) {
+  RateControl at_target(1920);
+  EXPECT_DOUBLE_EQ(at_target.Update(1920), 0);
+
+  RateControl draining(1920);
+  double adjust = 0;
+  for (int i = 0; i < 100; ++i) {
+    adjust = draining.Update(480);
+  }
+  // a draining ring asks for more samples, but never past the limit.
+  EXPECT_GT(adjust, 0);
+  EXPECT_LE(adjust, RateControl::kMaxAdjust);
+
+  RateControl overfull(1920);
+  for (int i = 0; i < 100; ++i) {
+    adjust = overfull.Update(4096);
+  }
+  EXPECT_DOUBLE_EQ(adjust, -RateControl::kMaxAdjust);
+}
+
+TEST(RateControl, SmoothsCallbackBursts) {
+  RateControl control(1920);
+  // one callback of 512 frames just drained the ring, the average barely moves.
+  double adjust = control.Update(1920 - 512);
+  EXPECT_LT(adjust, RateControl::kMaxAdjust * 0.1);
+}
+
+}  // namespace
+}  // namespace APU
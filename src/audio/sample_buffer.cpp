@@ -0,0 +1,179 @@
+//
+// Created by Brian Bonafilia on 1/5/25.
+//
+
+#include "sample_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include "../rendering/simd.h"
+
+namespace APU {
+
+namespace {
+
+constexpr int kTaps = SampleBuffer::kKernelTaps;
+constexpr int kPhases = SampleBuffer::kKernelPhases;
+// Cutoff of the kernel as a fraction of the sample rate, a little under
+// Nyquist so the window has room to roll off.
+constexpr double kCutoff = 0.45;
+// Pole of the DC blocker, about a 5 Hz corner at 48 kHz.
+constexpr float kBlockerPole = 0.9993f;
+
+struct StepKernels {
+  alignas(32) float taps[kPhases][kTaps];
+};
+
+// Blackman windowed sinc impulse for every phase, each normalized to sum to
+// 1 so that integrating the deltas settles at exactly the step.
+StepKernels MakeKernels() {
+  StepKernels kernels{};
+  for (int phase = 0; phase < kPhases; ++phase) {
+    double sum = 0;
+    double taps[kTaps];
+    for (int i = 0; i < kTaps; ++i) {
+      double x = i - (kTaps / 2 - 1) - static_cast<double>(phase) / kPhases;
+      double t = M_PI * 2 * kCutoff * x;
+      double sinc = x == 0 ? 1 : std::sin(t) / t;
+      double w = 2 * M_PI * (x + kTaps / 2) / kTaps;
+      double window = 0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2 * w);
+      taps[i] = sinc * window;
+      sum += taps[i];
+    }
+    for (int i = 0; i < kTaps; ++i) {
+      kernels.taps[phase][i] = static_cast<float>(taps[i] / sum);
+    }
+  }
+  return kernels;
+}
+
+const StepKernels &Kernels() {
+  static const StepKernels kernels = MakeKernels();
+  return kernels;
+}
+
+void AddKernelScalar(const float *kernel, float delta, float *out) {
+  for (int i = 0; i < kTaps; ++i) {
+    out[i] += kernel[i] * delta;
+  }
+}
+
+#ifdef GB_EMU_X86_KERNELS
+
+void AddKernelSse2(const float *kernel, float delta, float *out) {
+  __m128 scale = _mm_set1_ps(delta);
+  for (int i = 0; i < kTaps; i += 4) {
+    __m128 taps = _mm_load_ps(kernel + i);
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(taps, scale)));
+  }
+}
+
+__attribute__((target("avx2")))
+void AddKernelAvx2(const float *kernel, float delta, float *out) {
+  __m256 scale = _mm256_set1_ps(delta);
+  for (int i = 0; i < kTaps; i += 8) {
+    __m256 taps = _mm256_load_ps(kernel + i);
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(taps, scale)));
+  }
+}
+
+#endif
+
+int16_t ToSample(float level) {
+  return static_cast<int16_t>(std::clamp(std::lround(level), -32768L, 32767L));
+}
+
+auto AddKernelFor(PPU::SimdLevel level) -> void (*)(const float *, float, float *) {
+#ifdef GB_EMU_X86_KERNELS
+  switch (level) {
+    case PPU::avx2_kernels:
+      return AddKernelAvx2;
+    case PPU::sse2_kernels:
+      return AddKernelSse2;
+    default:
+      break;
+  }
+#endif
+  return AddKernelScalar;
+}
+
+}  // namespace
+
+SampleBuffer::SampleBuffer(int clock_rate, int sample_rate, int capacity, PPU::SimdLevel level)
+    : nominal_samples_per_clock_((static_cast<uint64_t>(sample_rate) << 32) / clock_rate),
+      samples_per_clock_(nominal_samples_per_clock_),
+      next_samples_per_clock_(nominal_samples_per_clock_),
+      capacity_(capacity * 2),
+      add_kernel_(AddKernelFor(level)),
+      deltas_{std::vector<float>(kMaxFrameSamples + kTaps), std::vector<float>(kMaxFrameSamples + kTaps)} {
+  samples_.reserve(capacity_);
+}
+
+void SampleBuffer::Reset(uint64_t clock) {
+  base_clock_ = clock;
+  base_fraction_ = 0;
+  for (int side = 0; side < 2; ++side) {
+    std::fill(deltas_[side].begin(), deltas_[side].end(), 0.0f);
+    level_[side] = 0;
+    blocker_input_[side] = 0;
+    blocker_output_[side] = 0;
+  }
+  samples_.clear();
+}
+
+void SampleBuffer::SetRateAdjust(double adjust) {
+  next_samples_per_clock_ = static_cast<uint64_t>(nominal_samples_per_clock_ * (1 + adjust));
+}
+
+uint64_t SampleBuffer::SamplePosition(uint64_t clock) const {
+  return (clock - base_clock_) * samples_per_clock_ + base_fraction_;
+}
+
+void SampleBuffer::AddDelta(uint64_t clock, int left, int right) {
+  uint64_t position = SamplePosition(clock);
+  size_t sample = position >> 32;
+  const float *kernel = Kernels().taps[(position >> (32 - 6)) & (kPhases - 1)];
+  static_assert(kPhases == 1 << 6, "the phase is the top 6 bits of the fraction");
+  if (left != 0) {
+    add_kernel_(kernel, static_cast<float>(left), deltas_[0].data() + sample);
+  }
+  if (right != 0) {
+    add_kernel_(kernel, static_cast<float>(right), deltas_[1].data() + sample);
+  }
+}
+
+void SampleBuffer::EndFrame(uint64_t clock) {
+  uint64_t position = SamplePosition(clock);
+  size_t count = position >> 32;
+  for (size_t i = 0; i < count; ++i) {
+    float out[2];
+    for (int side = 0; side < 2; ++side) {
+      level_[side] += deltas_[side][i];
+      // y[n] = x[n] - x[n - 1] + pole * y[n - 1]
+      out[side] = level_[side] - blocker_input_[side] + kBlockerPole * blocker_output_[side];
+      blocker_input_[side] = level_[side];
+      blocker_output_[side] = out[side];
+    }
+    if (samples_.size() < capacity_) {
+      samples_.push_back(ToSample(out[0]));
+      samples_.push_back(ToSample(out[1]));
+    }
+  }
+  // the kernels of steps near clock reach into the samples after it.
+  for (std::vector<float> &deltas : deltas_) {
+    std::copy(deltas.begin() + count, deltas.end(), deltas.begin());
+    std::fill(deltas.end() - count, deltas.end(), 0.0f);
+  }
+  base_clock_ = clock;
+  base_fraction_ = position & 0xFFFFFFFF;
+  samples_per_clock_ = next_samples_per_clock_;
+}
+
+int SampleBuffer::ReadSamples(int16_t *out, int max_frames) {
+  int frames = std::min(max_frames, SamplesAvailable());
+  std::copy(samples_.begin(), samples_.begin() + frames * 2, out);
+  samples_.erase(samples_.begin(), samples_.begin() + frames * 2);
+  return frames;
+}
+
+}  // namespace APU
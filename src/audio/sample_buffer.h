@@ -0,0 +1,82 @@
+//
+// Created by Brian Bonafilia on 1/5/25.
+//
+
+#ifndef GB_EMU_SRC_AUDIO_SAMPLE_BUFFER_H_
+#define GB_EMU_SRC_AUDIO_SAMPLE_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../rendering/pixel_kernels.h"
+
+// Turns the steps of the APU output, stamped with the clock they happened
+// at, into stereo 16 bit samples. Only changes are recorded, so a channel
+// holding its level costs nothing between samples.
+//
+// Every step is band limited where it lands: a windowed sinc kernel for the
+// fraction of a sample it happens at is added to the pending deltas, which
+// are integrated into samples later. Square and noise edges come out without
+// the aliasing of point sampling, for one short kernel add per edge. A high
+// pass then removes the DC offset of the unipolar channel outputs.
+namespace APU {
+
+class SampleBuffer {
+ public:
+  // capacity is in stereo frames, samples made while it is full are dropped.
+  SampleBuffer(int clock_rate, int sample_rate, int capacity, PPU::SimdLevel level = PPU::DetectSimdLevel());
+
+  // Start over at clock with silence.
+  void Reset(uint64_t clock);
+
+  // Step the left and right outputs by the deltas at clock, which must not
+  // be before the last EndFrame.
+  void AddDelta(uint64_t clock, int left, int right);
+
+  // Complete every sample before clock, making them readable. At most
+  // kMaxFrameSamples samples may lie between two calls.
+  void EndFrame(uint64_t clock);
+
+  // Stretch the ratio of samples to clocks by 1 + adjust, for rate control.
+  // Takes effect at the next EndFrame, so steps already added keep their
+  // sample positions.
+  void SetRateAdjust(double adjust);
+
+  int SamplesAvailable() const {
+    return static_cast<int>(samples_.size() / 2);
+  }
+
+  // Move up to max_frames interleaved left/right frames to out, returns how
+  // many were written.
+  int ReadSamples(int16_t* out, int max_frames);
+
+  static constexpr int kMaxFrameSamples = 1024;
+  // Width of the step kernel in samples, the output lags by half of it.
+  static constexpr int kKernelTaps = 16;
+  // Sub-sample positions the kernel is tabulated for.
+  static constexpr int kKernelPhases = 64;
+
+ private:
+  // Samples from base_clock_ to the clock, in 32.32 fixed point.
+  uint64_t SamplePosition(uint64_t clock) const;
+
+  const uint64_t nominal_samples_per_clock_;
+  uint64_t samples_per_clock_;
+  uint64_t next_samples_per_clock_;
+  const size_t capacity_;
+  void (*const add_kernel_)(const float* kernel, float delta, float* out);
+  uint64_t base_clock_ = 0;
+  // Fraction of a sample base_clock_ is past the start of the deltas.
+  uint64_t base_fraction_ = 0;
+  // Pending deltas of the samples from base_clock_ on, one side each.
+  std::vector<float> deltas_[2];
+  // Integrated level and the DC blocker state of each side.
+  float level_[2]{};
+  float blocker_input_[2]{};
+  float blocker_output_[2]{};
+  std::vector<int16_t> samples_;
+};
+
+}  // namespace APU
+
+#endif //GB_EMU_SRC_AUDIO_SAMPLE_BUFFER_H_
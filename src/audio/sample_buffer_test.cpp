@@ -0,0 +1,103 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#include "sample_buffer.h"
+
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace APU {
+namespace {
+
+constexpr int kClockRate = 4194304;
+constexpr int kSampleRate = 48000;
+
+std::vector<int16_t> ReadAll(SampleBuffer &buffer) {
+  std::vector<int16_t> samples(buffer.SamplesAvailable() * 2);
+  buffer.ReadSamples(samples.data(), buffer.SamplesAvailable());
+  return samples;
+}
+
+TEST(SampleBuffer, StepSettlesAtItsHeight) {
+  SampleBuffer buffer(kClockRate, kSampleRate, kSampleRate);
+  buffer.Reset(0);
+  buffer.AddDelta(1000, 10000, -5000);
+  // 64 samples and a bit.
+  buffer.EndFrame(5600);
+  std::vector<int16_t> samples = ReadAll(buffer);
+  ASSERT_EQ(samples.size(), 128u);
+  // silence before the step and its half kernel of delay.
+  EXPECT_EQ(samples[0], 0);
+  EXPECT_EQ(samples[1], 0);
+  // only the DC blocker pulls it back, slowly.
+  EXPECT_NEAR(samples[40 * 2], 10000, 300);
+  EXPECT_NEAR(samples[40 * 2 + 1], -5000, 150);
+}
+
+TEST(SampleBuffer, SplitFramesMatchOneFrame) {
+  SampleBuffer whole(kClockRate, kSampleRate, kSampleRate);
+  SampleBuffer split(kClockRate, kSampleRate, kSampleRate);
+  whole.Reset(0);
+  split.Reset(0);
+  for (uint64_t clock = 0; clock < 60000; clock += 331) {
+    whole.AddDelta(clock, clock % 2 ? 900 : -900, 0);
+    split.AddDelta(clock, clock % 2 ? 900 : -900, 0);
+    if (clock % 7 == 0) {
+      split.EndFrame(clock + 1);
+    }
+  }
+  whole.EndFrame(60000);
+  split.EndFrame(60000);
+  EXPECT_EQ(ReadAll(whole), ReadAll(split));
+}
+
+TEST(SampleBuffer, RateAdjustStretchesTheOutput) {
+  constexpr uint64_t kFrameClocks = 70224;
+  SampleBuffer nominal(kClockRate, kSampleRate, kSampleRate * 2);
+  SampleBuffer faster(kClockRate, kSampleRate, kSampleRate * 2);
+  nominal.Reset(0);
+  faster.Reset(0);
+  // from the second frame on.
+  faster.SetRateAdjust(0.005);
+  for (uint64_t clock = kFrameClocks; clock <= 60 * kFrameClocks; clock += kFrameClocks) {
+    nominal.EndFrame(clock);
+    faster.EndFrame(clock);
+  }
+  int extra = faster.SamplesAvailable() - nominal.SamplesAvailable();
+  // 0.5% of the 59 adjusted frames.
+  EXPECT_NEAR(extra, nominal.SamplesAvailable() * 0.005 * 59 / 60, 2);
+}
+
+TEST(SampleBuffer, SimdMatchesScalar) {
+  if (PPU::DetectSimdLevel() == PPU::scalar_kernels) {
+    GTEST_SKIP() << "no SIMD kernels on this CPU";
+  }
+  SampleBuffer scalar(kClockRate, kSampleRate, kSampleRate, PPU::scalar_kernels);
+  SampleBuffer simd(kClockRate, kSampleRate, kSampleRate, PPU::DetectSimdLevel());
+  scalar.Reset(0);
+  simd.Reset(0);
+  srand(1);
+  uint64_t clock = 0;
+  for (int frame = 0; frame < 20; ++frame) {
+    for (int i = 0; i < 200; ++i) {
+      clock += rand() % 300;
+      int left = rand() % 2000 - 1000;
+      int right = rand() % 2000 - 1000;
+      scalar.AddDelta(clock, left, right);
+      simd.AddDelta(clock, left, right);
+    }
+    scalar.EndFrame(clock);
+    simd.EndFrame(clock);
+  }
+  std::vector<int16_t> expected = ReadAll(scalar);
+  std::vector<int16_t> actual = ReadAll(simd);
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_NEAR(expected[i], actual[i], 1) << i;
+  }
+}
+
+}  // namespace
+}  // namespace APU
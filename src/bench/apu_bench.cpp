@@ -0,0 +1,105 @@
+//
+// Created by Brian Bonafilia on 1/6/25.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../apu.h"
+#include "../cpu.h"
+#include "../audio/sample_buffer.h"
+
+// Measures samples/sec of the band limited sample buffer at each SIMD level
+// on a dense stream of steps, and of the whole APU with all four channels
+// playing, counting only the time spent catching up.
+namespace {
+
+constexpr int kSeconds = 10;
+// Rough frame of emulation between two reads of the samples.
+constexpr int kCyclesPerRead = 70224;
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A step on both sides every 32 cycles, about 131k steps a second, more
+// than four busy channels make.
+void BenchBuffer(const char *name, PPU::SimdLevel level) {
+  APU::SampleBuffer buffer(APU::kClockRate, APU::kSampleRate, APU::kSampleRate, level);
+  buffer.Reset(0);
+  std::vector<int16_t> samples(APU::kSampleRate * 2);
+  uint64_t clock = 0;
+  int read = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int step = 0; clock < static_cast<uint64_t>(kSeconds) * APU::kClockRate; ++step) {
+    int delta = step % 2 ? 3000 : -3000;
+    buffer.AddDelta(clock, delta, -delta);
+    clock += 32;
+    if (step % 256 == 0) {
+      buffer.EndFrame(clock);
+      read += buffer.ReadSamples(samples.data(), APU::kSampleRate);
+    }
+  }
+  double seconds = SecondsSince(start);
+  printf("buffer %-6s %8.2f Msamples/s (%.0fx realtime)\n", name, read / seconds / 1e6,
+         kSeconds / seconds);
+}
+
+void Write(uint16_t addr, uint8_t val) {
+  CPU::access<CPU::write>(addr, val);
+}
+
+void BenchApu() {
+  CPU::InitializeRegisters(false);
+  CPU::SetPpuEnabled(false);
+  Write(0xFF25, 0xFF);
+  // square 1 sweeping down from a high note, square 2 at 1 kHz.
+  Write(0xFF10, 0x7F);
+  Write(0xFF11, 0x80);
+  Write(0xFF12, 0xF0);
+  Write(0xFF13, 0xF0);
+  Write(0xFF14, 0x87);
+  Write(0xFF16, 0x40);
+  Write(0xFF17, 0xF0);
+  Write(0xFF18, 0x83);
+  Write(0xFF19, 0x87);
+  // a triangle on the wave channel and fast noise.
+  for (int i = 0; i < 16; ++i) {
+    Write(0xFF30 + i, i < 8 ? i * 0x22 + 0x01 : (15 - i) * 0x22 + 0x10);
+  }
+  Write(0xFF1A, 0x80);
+  Write(0xFF1C, 0x20);
+  Write(0xFF1D, 0x00);
+  Write(0xFF1E, 0x87);
+  Write(0xFF21, 0xF0);
+  Write(0xFF22, 0x11);
+  Write(0xFF23, 0x80);
+
+  std::vector<int16_t> samples(APU::kSampleRate * 2);
+  double seconds = 0;
+  int read = 0;
+  int reads = kSeconds * APU::kClockRate / kCyclesPerRead;
+  for (int i = 0; i < reads; ++i) {
+    for (int cycle = 0; cycle < kCyclesPerRead; cycle += 4) {
+      CPU::Tick();
+    }
+    auto start = std::chrono::steady_clock::now();
+    read += APU::ReadSamples(samples.data(), APU::kSampleRate);
+    seconds += SecondsSince(start);
+  }
+  printf("apu           %8.2f Msamples/s (%.0fx realtime)\n", read / seconds / 1e6, kSeconds / seconds);
+}
+
+}  // namespace
+
+int main() {
+  BenchBuffer("scalar", PPU::scalar_kernels);
+  if (PPU::DetectSimdLevel() >= PPU::sse2_kernels) {
+    BenchBuffer("sse2", PPU::sse2_kernels);
+  }
+  if (PPU::DetectSimdLevel() >= PPU::avx2_kernels) {
+    BenchBuffer("avx2", PPU::avx2_kernels);
+  }
+  BenchApu();
+}
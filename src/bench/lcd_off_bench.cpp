@@ -0,0 +1,52 @@
+//
+// Created by Brian Bonafilia on 12/24/24.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include "../cpu.h"
+
+// Measures a load screen: a loop copying tile data into VRAM, run once with
+// the LCD on and once with it off the way games do for big loads.
+namespace {
+
+constexpr int kInstructions = 20'000'000;
+
+// Copies 0x1800 bytes from 0xC100 to 0x8000 forever.
+constexpr uint8_t kVramLoadLoop[] = {
+    0x21, 0x00, 0x80,  // LD HL, 0x8000
+    0x11, 0x00, 0xC1,  // LD DE, 0xC100
+    0x1A,              // LD A, [DE]
+    0x13,              // INC DE
+    0x22,              // LD [HL+], A
+    0x7C,              // LD A, H
+    0xFE, 0x98,        // CP 0x98
+    0x20, 0xF8,        // JR NZ, -8
+    0x18, 0xF0,        // JR -16
+};
+
+double RunLoad(uint8_t lcdc) {
+  CPU::InitializeRegisters();
+  CPU::access<CPU::write>(0xFF40, lcdc);
+  for (int i = 0; i < (int) sizeof(kVramLoadLoop); ++i) {
+    CPU::access<CPU::write>(0xC000 + i, kVramLoadLoop[i]);
+  }
+  CPU::GetRegisters().PC = 0xC000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInstructions; ++i) {
+    CPU::ProcessInstruction();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CPU::access<CPU::write>(0xFF40, 0x91);
+  return kInstructions / seconds / 1e6;
+}
+
+}  // namespace
+
+int main() {
+  double lcd_on = RunLoad(0x91);
+  double lcd_off = RunLoad(0x11);
+  printf("vram load, LCD on:  %.2f M instructions/s\n", lcd_on);
+  printf("vram load, LCD off: %.2f M instructions/s (%.1fx)\n", lcd_off, lcd_off / lcd_on);
+}
@@ -0,0 +1,162 @@
+//
+// Created by Brian Bonafilia on 12/18/24.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "../cpu.h"
+#include "../memory_arena.h"
+#include "../ppu.h"
+#include "../ppu_worker.h"
+#include "../rendering/indexed_frame.h"
+
+// Measures lines/sec of each PPU render mode on a busy synthetic scene: random
+// tiles and CGB attributes, scrolled BG, the window and 10 OBJs per line.
+namespace {
+
+constexpr int kDotsPerFrame = 70224;
+constexpr int kFrames = 120;
+
+uint32_t seed = 1;
+
+uint8_t Random() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+void SetUpScene(bool cgb_mode) {
+  seed = 1;
+  CPU::InitializeRegisters(cgb_mode);
+  for (int bank = 0; bank < 2; ++bank) {
+    CPU::access<CPU::write>(0xFF4F, bank);
+    for (int addr = 0x8000; addr < 0xA000; ++addr) {
+      CPU::access<CPU::write>(addr, Random());
+    }
+  }
+  CPU::access<CPU::write>(0xFF4F, 0);
+  // 40 OBJs spread so every line has a full OAM buffer.
+  for (int i = 0; i < 40; ++i) {
+    CPU::access<CPU::write>(0xFE00 + i * 4, 16 + (i % 20) * 8);
+    CPU::access<CPU::write>(0xFE00 + i * 4 + 1, 8 + i * 4);
+    CPU::access<CPU::write>(0xFE00 + i * 4 + 2, Random());
+    CPU::access<CPU::write>(0xFE00 + i * 4 + 3, Random());
+  }
+  CPU::access<CPU::write>(0xFF68, 0x80);
+  CPU::access<CPU::write>(0xFF6A, 0x80);
+  for (int i = 0; i < 64; ++i) {
+    CPU::access<CPU::write>(0xFF69, Random());
+    CPU::access<CPU::write>(0xFF6B, Random());
+  }
+  CPU::access<CPU::write>(0xFF40, 0xF7);
+  CPU::access<CPU::write>(0xFF42, 13);
+  CPU::access<CPU::write>(0xFF43, 37);
+  CPU::access<CPU::write>(0xFF47, 0xE4);
+  CPU::access<CPU::write>(0xFF48, 0xD2);
+  CPU::access<CPU::write>(0xFF49, 0x1B);
+  CPU::access<CPU::write>(0xFF4A, 72);
+  CPU::access<CPU::write>(0xFF4B, 87);
+}
+
+// With raster_effects SCX is rewritten every 57 dots, many times per line.
+double RunFrames(int frames, bool raster_effects = false) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frames * kDotsPerFrame; ++i) {
+    if (raster_effects && i % 57 == 0) {
+      CPU::access<CPU::write>(0xFF43, i >> 6);
+    }
+    PPU::dot();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// CPU time of the calling thread. Unlike wall time it leaves out the worker
+// thread when both have to share a core.
+double ThreadSeconds() {
+  timespec now{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int CountMismatches(const uint32_t *expected, const uint32_t *actual) {
+  int mismatches = 0;
+  for (int i = 0; i < Memory::kScreenWidth * Memory::kScreenHeight; ++i) {
+    mismatches += expected[i] != actual[i];
+  }
+  return mismatches;
+}
+
+void Bench(const char *name, bool cgb_mode) {
+  static uint32_t dot_frame[Memory::kScreenWidth * Memory::kScreenHeight];
+
+  SetUpScene(cgb_mode);
+  PPU::set_render_mode(PPU::dot_renderer);
+  double dot_seconds = RunFrames(kFrames);
+  memcpy(dot_frame, Memory::arena.pixels, sizeof(dot_frame));
+
+  SetUpScene(cgb_mode);
+  PPU::set_render_mode(PPU::scanline_renderer);
+  double scanline_seconds = RunFrames(kFrames);
+
+  int mismatches = CountMismatches(dot_frame, Memory::arena.pixels);
+  double lines = kFrames * 144.0;
+  printf("%s dot:      %8.0f lines/s\n", name, lines / dot_seconds);
+  printf("%s scanline: %8.0f lines/s (%.1fx, %d pixels differ from dot)\n", name,
+         lines / scanline_seconds, dot_seconds / scanline_seconds, mismatches);
+
+  // Same scene drawn as palette entries, expanded to RGB afterwards.
+  static uint32_t expanded[Memory::kScreenWidth * Memory::kScreenHeight];
+  SetUpScene(cgb_mode);
+  PPU::set_frame_format(PPU::indexed_pixels);
+  double indexed_seconds = RunFrames(kFrames);
+  PPU::set_frame_format(PPU::rgb_pixels);
+  auto expand_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kFrames; ++i) {
+    PPU::ExpandIndexedFrame(PPU::indexed_frame(), expanded, Memory::kScreenWidth);
+  }
+  double expand_seconds = SecondsSince(expand_start);
+  mismatches = CountMismatches(dot_frame, expanded);
+  printf("%s indexed:  %8.0f lines/s, expanded at %.1f us/frame (%d pixels differ from dot)\n", name,
+         lines / indexed_seconds, expand_seconds * 1e6 / kFrames, mismatches);
+
+  // Mid line SCX writes, which the scanline renderer does not follow.
+  SetUpScene(cgb_mode);
+  PPU::set_render_mode(PPU::dot_renderer);
+  double raster_seconds = RunFrames(kFrames, true);
+  memcpy(dot_frame, Memory::arena.pixels, sizeof(dot_frame));
+
+  SetUpScene(cgb_mode);
+  PPU::set_render_mode(PPU::pipelined_renderer);
+  auto start = std::chrono::steady_clock::now();
+  double thread_start = ThreadSeconds();
+  RunFrames(kFrames, true);
+  double emulation_seconds = ThreadSeconds() - thread_start;
+  PPU::FlushWorker();
+  double pipelined_seconds = SecondsSince(start);
+  mismatches = CountMismatches(dot_frame, PPU::WorkerPixels());
+  PPU::set_render_mode(PPU::dot_renderer);
+  printf("%s raster dot:       %8.0f lines/s\n", name, lines / raster_seconds);
+  printf("%s raster pipelined: %8.0f lines/s on the emulation thread, %8.0f lines/s drawn "
+         "(%d pixels differ from dot)\n", name, lines / emulation_seconds, lines / pipelined_seconds, mismatches);
+
+  SetUpScene(cgb_mode);
+  PPU::set_render_mode(PPU::span_renderer);
+  double span_seconds = RunFrames(kFrames, true);
+  mismatches = CountMismatches(dot_frame, Memory::arena.pixels);
+  PPU::set_render_mode(PPU::dot_renderer);
+  printf("%s raster spans:     %8.0f lines/s (%.1fx, %d pixels differ from dot)\n", name,
+         lines / span_seconds, raster_seconds / span_seconds, mismatches);
+}
+
+}  // namespace
+
+int main() {
+  Bench("DMG", false);
+  Bench("CGB", true);
+}
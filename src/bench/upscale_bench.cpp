@@ -0,0 +1,53 @@
+//
+// Created by Brian Bonafilia on 1/2/25.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../rendering/upscale.h"
+
+// Measures the cost per frame of every upscale filter on a random four shade
+// frame, on one thread and split over every core.
+namespace {
+
+constexpr int kWidth = 160;
+constexpr int kHeight = 144;
+constexpr int kFrames = 200;
+
+std::vector<uint32_t> RandomFrame() {
+  constexpr uint32_t kShades[]{0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+  std::vector<uint32_t> frame(kWidth * kHeight);
+  uint32_t seed = 1;
+  for (uint32_t &pixel : frame) {
+    seed = seed * 1103515245 + 12345;
+    pixel = kShades[(seed >> 16) & 3];
+  }
+  return frame;
+}
+
+double AverageFrameUs(PPU::ScaleFilter filter, int threads, const std::vector<uint32_t> &in) {
+  int scale = PPU::ScaleFactor(filter);
+  std::vector<uint32_t> out(kWidth * scale * kHeight * scale);
+  PPU::Upscaler upscaler(filter, threads);
+  double total = 0;
+  for (int i = 0; i < kFrames; ++i) {
+    upscaler.Scale(in.data(), out.data(), kWidth * scale);
+    total += upscaler.last_frame_us();
+  }
+  return total / kFrames;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<uint32_t> in = RandomFrame();
+  int cores = std::max(1u, std::thread::hardware_concurrency());
+  for (PPU::ScaleFilter filter : {PPU::nearest_filter, PPU::scale2x_filter, PPU::scale3x_filter,
+                                  PPU::xbr_lite_filter}) {
+    printf("%-8s %7.1f us/frame on 1 thread, %7.1f us/frame on %d\n", PPU::FilterName(filter),
+           AverageFrameUs(filter, 1, in), AverageFrameUs(filter, cores, in), cores);
+  }
+}
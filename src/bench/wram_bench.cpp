@@ -0,0 +1,70 @@
+//
+// Created by Brian Bonafilia on 12/14/24.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include "../cpu.h"
+
+// Micro benchmark for CGB code that lives in and hammers banked WRAM.
+namespace {
+
+constexpr int kAccesses = 50'000'000;
+constexpr int kInstructions = 20'000'000;
+
+// Copies a loop into WRAM bank 0 which increments every byte of the banked
+// region 0xD000-0xDFFF and then selects the next bank through 0xFF70.
+constexpr uint8_t kWramLoop[] = {
+    0x21, 0x00, 0xD0,  // LD HL, 0xD000
+    0x7E,              // LD A, [HL]
+    0x3C,              // INC A
+    0x22,              // LD [HL+], A
+    0x7C,              // LD A, H
+    0xFE, 0xE0,        // CP 0xE0
+    0x20, 0xF8,        // JR NZ, -8
+    0xF0, 0x70,        // LDH A, [0x70]
+    0x3C,              // INC A
+    0xE0, 0x70,        // LDH [0x70], A
+    0x18, 0xEE,        // JR -18
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BenchAccess() {
+  uint32_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kAccesses; ++i) {
+    if ((i & 0xFFF) == 0) {
+      CPU::access<CPU::write>(0xFF70, (i >> 12) & 0x7);
+    }
+    uint16_t addr = 0xD000 | (i & 0xFFF);
+    CPU::access<CPU::write>(addr, i);
+    sum += CPU::access<CPU::read>(addr);
+  }
+  double seconds = SecondsSince(start);
+  printf("banked access: %.2f ns/access (checksum %X)\n", seconds * 1e9 / (kAccesses * 2.0), sum);
+}
+
+void BenchWramLoop() {
+  for (int i = 0; i < (int) sizeof(kWramLoop); ++i) {
+    CPU::access<CPU::write>(0xC000 + i, kWramLoop[i]);
+  }
+  CPU::GetRegisters().PC = 0xC000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInstructions; ++i) {
+    CPU::ProcessInstruction();
+  }
+  double seconds = SecondsSince(start);
+  printf("wram loop: %.2f M instructions/s\n", kInstructions / seconds / 1e6);
+}
+
+}  // namespace
+
+int main() {
+  CPU::InitializeRegisters(/*cgb_mode=*/true);
+  BenchAccess();
+  BenchWramLoop();
+}
@@ -0,0 +1,229 @@
+//
+// Created by Brian Bonafilia on 1/7/25.
+//
+
+#include "audio_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "../apu.h"
+#include "../spsc_queue.h"
+
+namespace Capture {
+namespace {
+
+// About 21 ms of audio per block.
+constexpr int kBlockFrames = 1024;
+// About a third of a second of blocks to absorb a slow disk.
+constexpr int kPoolSize = 16;
+constexpr int kHeaderSize = 44;
+
+struct Block {
+  // Position of the first frame in the stream, counted from StartAudio.
+  uint64_t first_frame;
+  int frames;
+  int16_t samples[kBlockFrames * 2];
+};
+
+Block pool[kPoolSize];
+// Indices into pool, as for the video capture.
+SpscQueue<int, kPoolSize> queued;
+SpscQueue<int, kPoolSize> free_blocks;
+
+FILE *file = nullptr;
+AudioTap audio_tap = mixer_audio;
+OverflowPolicy overflow_policy = drop_frames;
+std::atomic<bool> capturing{false};
+std::atomic<uint64_t> dropped{0};
+
+/* Producer side */
+// The block being filled, -1 for none.
+int current = -1;
+uint64_t next_frame = 0;
+
+/* Writer side */
+uint64_t written_frames = 0;
+
+void PutLe(uint8_t *out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out[i] = value >> (i * 8);
+  }
+}
+
+// The canonical 44 byte header of PCM data_bytes long.
+void WriteHeader(uint32_t data_bytes) {
+  constexpr int kChannels = 2;
+  constexpr int kBlockAlign = kChannels * sizeof(int16_t);
+  uint8_t header[kHeaderSize];
+  std::copy_n("RIFF", 4, header);
+  PutLe(header + 4, kHeaderSize - 8 + data_bytes, 4);
+  std::copy_n("WAVEfmt ", 8, header + 8);
+  PutLe(header + 16, 16, 4);
+  // PCM.
+  PutLe(header + 20, 1, 2);
+  PutLe(header + 22, kChannels, 2);
+  PutLe(header + 24, APU::kSampleRate, 4);
+  PutLe(header + 28, APU::kSampleRate * kBlockAlign, 4);
+  PutLe(header + 32, kBlockAlign, 2);
+  PutLe(header + 34, 16, 2);
+  std::copy_n("data", 4, header + 36);
+  PutLe(header + 40, data_bytes, 4);
+  fseek(file, 0, SEEK_SET);
+  fwrite(header, 1, sizeof(header), file);
+  fseek(file, 0, SEEK_END);
+}
+
+void WriteFrames(const int16_t *samples, int frames) {
+  uint8_t bytes[kBlockFrames * 4];
+  for (int i = 0; i < frames * 2; ++i) {
+    PutLe(bytes + i * 2, static_cast<uint16_t>(samples[i]), 2);
+  }
+  fwrite(bytes, 4, frames, file);
+  written_frames += frames;
+}
+
+void Write(const Block &block) {
+  // dropped blocks come back as silence, keeping later samples on time.
+  static const int16_t silence[kBlockFrames * 2] = {};
+  while (written_frames < block.first_frame) {
+    WriteFrames(silence, static_cast<int>(std::min<uint64_t>(kBlockFrames, block.first_frame - written_frames)));
+  }
+  WriteFrames(block.samples, block.frames);
+}
+
+struct Writer {
+  std::thread thread;
+  std::atomic<bool> stop_requested{false};
+
+  void Run() {
+    int block;
+    while (true) {
+      if (!queued.TryPop(block)) {
+        if (stop_requested.load(std::memory_order_acquire)) {
+          return;
+        }
+        // a block fills every 21ms, no need to spin for it.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        continue;
+      }
+      Write(pool[block]);
+      free_blocks.TryPush(block);
+    }
+  }
+
+  // Returns once everything queued before the call is written.
+  void Stop() {
+    if (thread.joinable()) {
+      stop_requested = true;
+      thread.join();
+      stop_requested = false;
+    }
+  }
+
+  ~Writer() {
+    Stop();
+  }
+};
+
+// Defined last so it is destroyed, and the thread stopped, before the state above.
+Writer writer;
+
+// A block to copy the next frames into, -1 to drop them.
+int AcquireBlock() {
+  int block;
+  while (!free_blocks.TryPop(block)) {
+    if (overflow_policy == drop_frames) {
+      return -1;
+    }
+    std::this_thread::yield();
+  }
+  pool[block].first_frame = next_frame;
+  pool[block].frames = 0;
+  return block;
+}
+
+}  // namespace
+
+bool StartAudio(const char *path, AudioTap tap, OverflowPolicy policy) {
+  StopAudio();
+  file = fopen(path, "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to open audio capture file %s\n", path);
+    return false;
+  }
+  audio_tap = tap;
+  overflow_policy = policy;
+  dropped = 0;
+  current = -1;
+  next_frame = 0;
+  written_frames = 0;
+  int block;
+  while (free_blocks.TryPop(block)) {
+  }
+  for (block = 0; block < kPoolSize; ++block) {
+    free_blocks.TryPush(block);
+  }
+  WriteHeader(0);
+  writer.thread = std::thread(&Writer::Run, &writer);
+  capturing = true;
+  return true;
+}
+
+void StopAudio() {
+  if (!capturing) {
+    return;
+  }
+  capturing = false;
+  if (current >= 0) {
+    queued.TryPush(current);
+    current = -1;
+  }
+  writer.Stop();
+  WriteHeader(static_cast<uint32_t>(written_frames * 4));
+  fclose(file);
+  file = nullptr;
+}
+
+bool IsCapturingAudio(AudioTap tap) {
+  return capturing.load(std::memory_order_relaxed) && audio_tap == tap;
+}
+
+void SubmitAudio(AudioTap tap, const int16_t *samples, int frames) {
+  if (!IsCapturingAudio(tap)) {
+    return;
+  }
+  while (frames > 0) {
+    if (current < 0) {
+      current = AcquireBlock();
+    }
+    if (current < 0) {
+      // no block free, skip what would have filled one.
+      int skipped = std::min(frames, kBlockFrames);
+      dropped.fetch_add(skipped, std::memory_order_relaxed);
+      next_frame += skipped;
+      samples += skipped * 2;
+      frames -= skipped;
+      continue;
+    }
+    Block &block = pool[current];
+    int count = std::min(frames, kBlockFrames - block.frames);
+    std::copy_n(samples, count * 2, block.samples + block.frames * 2);
+    block.frames += count;
+    next_frame += count;
+    samples += count * 2;
+    frames -= count;
+    if (block.frames == kBlockFrames) {
+      queued.TryPush(current);
+      current = -1;
+    }
+  }
+}
+
+uint64_t DroppedAudioFrames() {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace Capture
@@ -0,0 +1,53 @@
+//
+// Created by Brian Bonafilia on 1/7/25.
+//
+
+#ifndef GB_EMU_SRC_CAPTURE_AUDIO_CAPTURE_H_
+#define GB_EMU_SRC_CAPTURE_AUDIO_CAPTURE_H_
+
+#include <cstdint>
+#include "frame_capture.h"
+
+// Records the sound output to a 16 bit stereo WAV file. Samples are copied
+// into a block from a fixed pool as they are made, and a writer thread
+// writes out full blocks, so neither the emulation thread nor the audio
+// callback ever waits on the disk.
+//
+// Every block carries the position of its first sample in the stream. When
+// blocks are dropped the writer fills the hole with silence, so sample n of
+// the file is always n / 48000 s after Start. The video capture keeps the
+// same time by clock stamps, so the two started at the same clock can be
+// muxed as they are.
+namespace Capture {
+
+// Where the samples are taken from.
+enum AudioTap {
+  // The APU mix, resampled at exactly 48000 samples per 4194304 clocks
+  // however the audio device is paced. Stays in step with a Y4M capture.
+  mixer_audio,
+  // The samples handed to the audio device, after rate control stretched
+  // them by up to 0.5%. What was heard.
+  device_audio
+};
+
+// Start recording tap to path, stopping any audio capture in progress. False
+// if the file could not be opened. Like the video Start and Stop, call them
+// while no samples are being made.
+bool StartAudio(const char* path, AudioTap tap, OverflowPolicy policy);
+
+// Write out the samples still queued, complete the header and close the file.
+void StopAudio();
+
+// Whether tap is being recorded.
+bool IsCapturingAudio(AudioTap tap);
+
+// Queue interleaved left/right frames made at tap, ignored unless tap is
+// the one recorded. Always called from the thread that makes them.
+void SubmitAudio(AudioTap tap, const int16_t* samples, int frames);
+
+// Frames replaced by silence under drop_frames since StartAudio.
+uint64_t DroppedAudioFrames();
+
+}  // namespace Capture
+
+#endif //GB_EMU_SRC_CAPTURE_AUDIO_CAPTURE_H_
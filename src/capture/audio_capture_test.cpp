@@ -0,0 +1,74 @@
+//
+// Created by Brian Bonafilia on 1/7/25.
+//
+
+#include "audio_capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace Capture {
+namespace {
+
+constexpr char kPath[] = "audio_capture_test.wav";
+
+std::vector<uint8_t> ReadFile(const char *path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+uint32_t Le32(const std::vector<uint8_t> &bytes, int offset) {
+  return bytes[offset] | bytes[offset + 1] << 8 | bytes[offset + 2] << 16 | bytes[offset + 3] << 24;
+}
+
+int16_t Sample(const std::vector<uint8_t> &bytes, int index) {
+  return static_cast<int16_t>(bytes[44 + index * 2] | bytes[45 + index * 2] << 8);
+}
+
+TEST(AudioCapture, WritesACompleteWav) {
+  ASSERT_TRUE(StartAudio(kPath, mixer_audio, block_until_written));
+  EXPECT_TRUE(IsCapturingAudio(mixer_audio));
+  EXPECT_FALSE(IsCapturingAudio(device_audio));
+  // across several pooled blocks, in uneven pieces.
+  std::vector<int16_t> samples;
+  for (int i = 0; i < 5000; ++i) {
+    samples.push_back(i);
+    samples.push_back(-i);
+  }
+  for (int first = 0; first < 5000; first += 777) {
+    SubmitAudio(mixer_audio, samples.data() + first * 2, std::min(777, 5000 - first));
+  }
+  // not the recorded tap.
+  SubmitAudio(device_audio, samples.data(), 100);
+  StopAudio();
+  EXPECT_EQ(DroppedAudioFrames(), 0u);
+
+  std::vector<uint8_t> bytes = ReadFile(kPath);
+  ASSERT_EQ(bytes.size(), 44u + 5000 * 4);
+  EXPECT_EQ(std::string(bytes.begin(), bytes.begin() + 4), "RIFF");
+  EXPECT_EQ(Le32(bytes, 4), bytes.size() - 8);
+  EXPECT_EQ(std::string(bytes.begin() + 8, bytes.begin() + 16), "WAVEfmt ");
+  EXPECT_EQ(Le32(bytes, 24), 48000u);
+  EXPECT_EQ(std::string(bytes.begin() + 36, bytes.begin() + 40), "data");
+  EXPECT_EQ(Le32(bytes, 40), 5000u * 4);
+  for (int i = 0; i < 5000; ++i) {
+    ASSERT_EQ(Sample(bytes, i * 2), static_cast<int16_t>(i));
+    ASSERT_EQ(Sample(bytes, i * 2 + 1), static_cast<int16_t>(-i));
+  }
+  std::remove(kPath);
+}
+
+TEST(AudioCapture, IgnoresSamplesWhenStopped) {
+  EXPECT_FALSE(IsCapturingAudio(mixer_audio));
+  int16_t samples[2]{1, 2};
+  SubmitAudio(mixer_audio, samples, 1);
+  StopAudio();
+}
+
+}  // namespace
+}  // namespace Capture
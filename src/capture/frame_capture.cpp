@@ -0,0 +1,236 @@
+//
+// Created by Brian Bonafilia on 1/3/25.
+//
+
+#include "frame_capture.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "yuv.h"
+#include "../spsc_queue.h"
+#include "../rendering/indexed_frame.h"
+
+namespace Capture {
+namespace {
+
+constexpr int kWidth = Memory::kScreenWidth;
+constexpr int kHeight = Memory::kScreenHeight;
+constexpr int kPixels = kWidth * kHeight;
+// About an eighth of a second of frames to absorb a slow disk.
+constexpr int kPoolSize = 8;
+// CPU clocks in a frame period, 154 lines of 456 dots.
+constexpr uint64_t kFrameClocks = 70224;
+
+// A pooled frame, in the format it was drawn in.
+struct Frame {
+  uint64_t clock;
+  bool indexed;
+  uint32_t pixels[kPixels];
+  PPU::IndexedFrame indexed_frame;
+};
+
+Frame pool[kPoolSize];
+// Indices into pool. Buffers go to the writer through queued and come back
+// through free_buffers.
+SpscQueue<int, kPoolSize> queued;
+SpscQueue<int, kPoolSize> free_buffers;
+
+FILE *file = nullptr;
+VideoFormat video_format = y4m_video;
+OverflowPolicy overflow_policy = drop_frames;
+std::atomic<bool> capturing{false};
+std::atomic<uint64_t> dropped{0};
+
+/* Writer side */
+uint64_t start_clock = 0;
+// Frame periods written to the file so far.
+uint64_t periods_written = 0;
+// Whether the buffers below hold a converted frame to repeat.
+bool converted = false;
+uint32_t expanded[kPixels];
+uint8_t planes[3][kPixels];
+uint8_t chroma[2][kPixels / 4];
+uint8_t rgb24[kPixels * 3];
+
+void WriteY4mHeader() {
+  // 4194304 / 70224 is 59.7275 fps.
+  fprintf(file, "YUV4MPEG2 W%d H%d F4194304:70224 Ip A1:1 C420jpeg\n", kWidth, kHeight);
+}
+
+// Frame period of the file clock falls in.
+uint64_t Period(uint64_t clock) {
+  return clock < start_clock ? 0 : (clock - start_clock) / kFrameClocks;
+}
+
+void Convert(const uint32_t *pixels) {
+  if (video_format == raw_rgb_video) {
+    for (int i = 0; i < kPixels; ++i) {
+      rgb24[i * 3] = pixels[i] >> 16;
+      rgb24[i * 3 + 1] = pixels[i] >> 8;
+      rgb24[i * 3 + 2] = pixels[i];
+    }
+  } else {
+    RgbToYuv(PPU::DetectSimdLevel(), pixels, kPixels, planes[0], planes[1], planes[2]);
+    Subsample420(planes[1], kWidth, kHeight, chroma[0]);
+    Subsample420(planes[2], kWidth, kHeight, chroma[1]);
+  }
+  converted = true;
+}
+
+// Write the last converted frame for every period before end.
+void WriteConvertedUntil(uint64_t end) {
+  if (!converted) {
+    return;
+  }
+  for (; periods_written < end; ++periods_written) {
+    if (video_format == raw_rgb_video) {
+      fwrite(rgb24, 1, sizeof(rgb24), file);
+      continue;
+    }
+    fputs("FRAME\n", file);
+    fwrite(planes[0], 1, kPixels, file);
+    fwrite(chroma[0], 1, sizeof(chroma[0]), file);
+    fwrite(chroma[1], 1, sizeof(chroma[1]), file);
+  }
+}
+
+void Write(const Frame &frame) {
+  uint64_t period = Period(frame.clock);
+  // periods since the last frame show it, it was still on screen.
+  WriteConvertedUntil(period);
+  if (frame.indexed) {
+    PPU::ExpandIndexedFrame(frame.indexed_frame, expanded, kWidth);
+    Convert(expanded);
+  } else {
+    Convert(frame.pixels);
+  }
+  // a second frame in a period that is already written only shows when
+  // repeated. Before the first frame there is nothing else to show.
+  WriteConvertedUntil(period + 1);
+}
+
+struct Writer {
+  std::thread thread;
+  std::atomic<bool> stop_requested{false};
+
+  void Run() {
+    int buffer;
+    while (true) {
+      if (!queued.TryPop(buffer)) {
+        if (stop_requested.load(std::memory_order_acquire)) {
+          return;
+        }
+        // a frame comes every 16ms, no need to spin for it.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      Write(pool[buffer]);
+      free_buffers.TryPush(buffer);
+    }
+  }
+
+  // Returns once everything queued before the call is written.
+  void Stop() {
+    if (thread.joinable()) {
+      stop_requested = true;
+      thread.join();
+      stop_requested = false;
+    }
+  }
+
+  ~Writer() {
+    Stop();
+  }
+};
+
+// Defined last so it is destroyed, and the thread stopped, before the state above.
+Writer writer;
+
+// A buffer to copy the next frame into, -1 to drop the frame.
+int AcquireBuffer() {
+  int buffer;
+  while (!free_buffers.TryPop(buffer)) {
+    if (overflow_policy == drop_frames) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return -1;
+    }
+    std::this_thread::yield();
+  }
+  return buffer;
+}
+
+}  // namespace
+
+bool Start(const char *path, VideoFormat format, OverflowPolicy policy, uint64_t clock) {
+  Stop(clock);
+  file = fopen(path, "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to open capture file %s\n", path);
+    return false;
+  }
+  video_format = format;
+  overflow_policy = policy;
+  dropped = 0;
+  start_clock = clock;
+  periods_written = 0;
+  converted = false;
+  int buffer;
+  while (free_buffers.TryPop(buffer)) {
+  }
+  for (buffer = 0; buffer < kPoolSize; ++buffer) {
+    free_buffers.TryPush(buffer);
+  }
+  if (format == y4m_video) {
+    WriteY4mHeader();
+  }
+  writer.thread = std::thread(&Writer::Run, &writer);
+  capturing = true;
+  return true;
+}
+
+void Stop(uint64_t clock) {
+  if (!capturing) {
+    return;
+  }
+  capturing = false;
+  writer.Stop();
+  // the writer is done, its state can be used from here.
+  WriteConvertedUntil(Period(clock));
+  fclose(file);
+  file = nullptr;
+}
+
+bool IsCapturing() {
+  return capturing.load(std::memory_order_relaxed);
+}
+
+void SubmitFrame(const uint32_t *pixels, uint64_t clock) {
+  int buffer = AcquireBuffer();
+  if (buffer < 0) {
+    return;
+  }
+  pool[buffer].clock = clock;
+  pool[buffer].indexed = false;
+  memcpy(pool[buffer].pixels, pixels, sizeof(pool[buffer].pixels));
+  queued.TryPush(buffer);
+}
+
+void SubmitIndexedFrame(const PPU::IndexedFrame &frame, uint64_t clock) {
+  int buffer = AcquireBuffer();
+  if (buffer < 0) {
+    return;
+  }
+  pool[buffer].clock = clock;
+  pool[buffer].indexed = true;
+  PPU::CopyIndexedFrame(frame, &pool[buffer].indexed_frame);
+  queued.TryPush(buffer);
+}
+
+uint64_t DroppedFrames() {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace Capture
@@ -0,0 +1,58 @@
+//
+// Created by Brian Bonafilia on 1/3/25.
+//
+
+#ifndef GB_EMU_SRC_CAPTURE_FRAME_CAPTURE_H_
+#define GB_EMU_SRC_CAPTURE_FRAME_CAPTURE_H_
+
+#include <cstdint>
+#include "../ppu.h"
+
+// Records every finished frame to a video file. Whoever finishes a frame
+// copies it into a buffer from a fixed pool, and a writer thread converts
+// and writes it, then hands the buffer back.
+//
+// Frames are stamped with the clock they finished at, and frame n of the file
+// is the one shown n frame periods of 70224 clocks after Start. Periods
+// without a frame of their own, because it was dropped or the LCD was off,
+// repeat the frame before, so the file runs at the emulated speed.
+namespace Capture {
+
+enum VideoFormat {
+  // YUV4MPEG2, 4:2:0 at the DMG frame rate, plays in ffmpeg and mpv.
+  y4m_video,
+  // Bare rgb24 frames, e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s 160x144.
+  raw_rgb_video
+};
+
+// What to do with a frame when the writer has fallen behind and every
+// pooled buffer is still queued.
+enum OverflowPolicy {
+  drop_frames,
+  // Wait for the writer, for captures that must not miss a frame.
+  block_until_written
+};
+
+// Start recording to path at CPU clock, stopping any capture in progress.
+// False if the file could not be opened. Start and Stop must not race with a
+// submit, call them while no frames are being drawn.
+bool Start(const char* path, VideoFormat format, OverflowPolicy policy, uint64_t clock);
+
+// Write out the frames still queued, repeat the last one up to the period
+// clock falls in and close the file.
+void Stop(uint64_t clock);
+
+bool IsCapturing();
+
+// Queue a frame finished at CPU clock, a single copy into a pooled buffer.
+// Always called from the thread that draws frames.
+void SubmitFrame(const uint32_t* pixels, uint64_t clock);
+void SubmitIndexedFrame(const PPU::IndexedFrame& frame, uint64_t clock);
+
+// Frames dropped under drop_frames since Start, their periods repeat the
+// frame before.
+uint64_t DroppedFrames();
+
+}  // namespace Capture
+
+#endif //GB_EMU_SRC_CAPTURE_FRAME_CAPTURE_H_
@@ -0,0 +1,55 @@
+//
+// Created by Brian Bonafilia on 1/9/25.
+//
+
+#include "frame_capture.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace Capture {
+namespace {
+
+constexpr char kPath[] = "frame_capture_test.rgb";
+constexpr int kPixels = Memory::kScreenWidth * Memory::kScreenHeight;
+constexpr uint64_t kFrameClocks = 70224;
+
+std::vector<uint8_t> ReadFile(const char *path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// First pixel of frame index of a raw RGB file, as 0xRRGGBB.
+uint32_t FramePixel(const std::vector<uint8_t> &bytes, int index) {
+  size_t offset = static_cast<size_t>(index) * kPixels * 3;
+  return bytes[offset] << 16 | bytes[offset + 1] << 8 | bytes[offset + 2];
+}
+
+TEST(FrameCapture, RepeatsFramesForPeriodsWithoutOne) {
+  constexpr uint64_t kStart = 1000;
+  ASSERT_TRUE(Start(kPath, raw_rgb_video, block_until_written, kStart));
+  std::vector<uint32_t> a(kPixels, 0x112233);
+  std::vector<uint32_t> b(kPixels, 0x445566);
+  std::vector<uint32_t> c(kPixels, 0x778899);
+  SubmitFrame(a.data(), kStart + 65000);
+  // periods 1 and 2 are missing, say the LCD was off.
+  SubmitFrame(b.data(), kStart + 3 * kFrameClocks + 10);
+  // a second frame in period 3 only shows once it is repeated.
+  SubmitFrame(c.data(), kStart + 3 * kFrameClocks + 500);
+  Stop(kStart + 5 * kFrameClocks + 1);
+
+  std::vector<uint8_t> bytes = ReadFile(kPath);
+  std::remove(kPath);
+  ASSERT_EQ(bytes.size(), 5u * kPixels * 3);
+  EXPECT_EQ(FramePixel(bytes, 0), 0x112233u);
+  EXPECT_EQ(FramePixel(bytes, 1), 0x112233u);
+  EXPECT_EQ(FramePixel(bytes, 2), 0x112233u);
+  EXPECT_EQ(FramePixel(bytes, 3), 0x445566u);
+  EXPECT_EQ(FramePixel(bytes, 4), 0x778899u);
+}
+
+}  // namespace
+}  // namespace Capture
@@ -0,0 +1,89 @@
+//
+// Created by Brian Bonafilia on 1/3/25.
+//
+
+#include "yuv.h"
+
+#include "../rendering/simd.h"
+
+namespace Capture {
+
+namespace {
+
+// Coefficients scaled by 256. The 0x8000 bias keeps u and v positive so all
+// of the math fits unsigned 16 bits, and adds the 128 chroma offset.
+constexpr int kChromaBias = 0x8000;
+
+void RgbToYuvScalar(const uint32_t *rgb, int count, uint8_t *y, uint8_t *u, uint8_t *v) {
+  for (int i = 0; i < count; ++i) {
+    int r = (rgb[i] >> 16) & 0xFF;
+    int g = (rgb[i] >> 8) & 0xFF;
+    int b = rgb[i] & 0xFF;
+    y[i] = (77 * r + 150 * g + 29 * b) >> 8;
+    u[i] = (kChromaBias - 43 * r - 85 * g + 128 * b) >> 8;
+    v[i] = (kChromaBias + 128 * r - 107 * g - 21 * b) >> 8;
+  }
+}
+
+#ifdef GB_EMU_X86_KERNELS
+
+// Eight pixels per step in 16 bit lanes. Sums wrap mod 2^16, which is fine
+// since every result ends up in range before the shift.
+void RgbToYuvSse2(const uint32_t *rgb, int count, uint8_t *y, uint8_t *u, uint8_t *v) {
+  const __m128i byte = _mm_set1_epi32(0xFF);
+  const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(kChromaBias));
+  auto coefficient = [](int c) {
+    return _mm_set1_epi16(static_cast<int16_t>(c));
+  };
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + i));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgb + i + 4));
+    __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), byte),
+                                _mm_and_si128(_mm_srli_epi32(high, 16), byte));
+    __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), byte),
+                                _mm_and_si128(_mm_srli_epi32(high, 8), byte));
+    __m128i b = _mm_packs_epi32(_mm_and_si128(low, byte), _mm_and_si128(high, byte));
+
+    __m128i luma = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, coefficient(77)),
+                                               _mm_mullo_epi16(g, coefficient(150))),
+                                 _mm_mullo_epi16(b, coefficient(29)));
+    __m128i blue = _mm_sub_epi16(_mm_add_epi16(bias, _mm_mullo_epi16(b, coefficient(128))),
+                                 _mm_add_epi16(_mm_mullo_epi16(r, coefficient(43)),
+                                               _mm_mullo_epi16(g, coefficient(85))));
+    __m128i red = _mm_sub_epi16(_mm_add_epi16(bias, _mm_mullo_epi16(r, coefficient(128))),
+                                _mm_add_epi16(_mm_mullo_epi16(g, coefficient(107)),
+                                              _mm_mullo_epi16(b, coefficient(21))));
+    __m128i zero = _mm_setzero_si128();
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(y + i), _mm_packus_epi16(_mm_srli_epi16(luma, 8), zero));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(u + i), _mm_packus_epi16(_mm_srli_epi16(blue, 8), zero));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(v + i), _mm_packus_epi16(_mm_srli_epi16(red, 8), zero));
+  }
+  RgbToYuvScalar(rgb + i, count - i, y + i, u + i, v + i);
+}
+
+#endif
+
+}  // namespace
+
+void RgbToYuv(PPU::SimdLevel level, const uint32_t *rgb, int count, uint8_t *y, uint8_t *u, uint8_t *v) {
+#ifdef GB_EMU_X86_KERNELS
+  if (level != PPU::scalar_kernels) {
+    RgbToYuvSse2(rgb, count, y, u, v);
+    return;
+  }
+#endif
+  RgbToYuvScalar(rgb, count, y, u, v);
+}
+
+void Subsample420(const uint8_t *plane, int width, int height, uint8_t *out) {
+  for (int row = 0; row < height; row += 2) {
+    const uint8_t *top = plane + row * width;
+    const uint8_t *bottom = top + width;
+    for (int col = 0; col < width; col += 2) {
+      *out++ = (top[col] + top[col + 1] + bottom[col] + bottom[col + 1] + 2) >> 2;
+    }
+  }
+}
+
+}  // namespace Capture
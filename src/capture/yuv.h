@@ -0,0 +1,23 @@
+//
+// Created by Brian Bonafilia on 1/3/25.
+//
+
+#ifndef GB_EMU_SRC_CAPTURE_YUV_H_
+#define GB_EMU_SRC_CAPTURE_YUV_H_
+
+#include <cstdint>
+#include "../rendering/pixel_kernels.h"
+
+namespace Capture {
+
+// Full range BT.601 (JPEG) conversion of count RGB888 pixels into one byte
+// per pixel in each of the y, u and v planes.
+void RgbToYuv(PPU::SimdLevel level, const uint32_t* rgb, int count, uint8_t* y, uint8_t* u, uint8_t* v);
+
+// Average every 2x2 block of a full resolution chroma plane, for 4:2:0.
+// width and height must be even.
+void Subsample420(const uint8_t* plane, int width, int height, uint8_t* out);
+
+}  // namespace Capture
+
+#endif //GB_EMU_SRC_CAPTURE_YUV_H_
@@ -0,0 +1,55 @@
+//
+// Created by Brian Bonafilia on 1/3/25.
+//
+
+#include "yuv.h"
+
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace Capture {
+namespace {
+
+TEST(Yuv, KnownColors) {
+  uint32_t rgb[]{0xFFFFFF, 0x000000, 0xFF0000, 0x0000FF};
+  uint8_t y[4], u[4], v[4];
+  RgbToYuv(PPU::scalar_kernels, rgb, 4, y, u, v);
+  EXPECT_EQ(y[0], 255);
+  EXPECT_EQ(u[0], 128);
+  EXPECT_EQ(v[0], 128);
+  EXPECT_EQ(y[1], 0);
+  EXPECT_EQ(u[1], 128);
+  EXPECT_EQ(v[1], 128);
+  // red is high in v, blue high in u.
+  EXPECT_EQ(y[2], 76);
+  EXPECT_GT(v[2], 250);
+  EXPECT_GT(u[3], 250);
+}
+
+TEST(Yuv, SimdMatchesScalar) {
+  if (PPU::DetectSimdLevel() == PPU::scalar_kernels) {
+    GTEST_SKIP() << "no SIMD kernels on this CPU";
+  }
+  // every value of each channel, plus a tail that is not a multiple of 8.
+  std::vector<uint32_t> rgb;
+  for (uint32_t i = 0; i < 0x10000 + 5; ++i) {
+    rgb.push_back((i * 2654435761u) & 0xFFFFFF);
+  }
+  int count = rgb.size();
+  std::vector<uint8_t> scalar(count * 3), simd(count * 3);
+  RgbToYuv(PPU::scalar_kernels, rgb.data(), count, scalar.data(), scalar.data() + count, scalar.data() + count * 2);
+  RgbToYuv(PPU::DetectSimdLevel(), rgb.data(), count, simd.data(), simd.data() + count, simd.data() + count * 2);
+  EXPECT_EQ(scalar, simd);
+}
+
+TEST(Yuv, Subsample420) {
+  uint8_t plane[]{0, 4, 10, 10,
+                  8, 4, 10, 10};
+  uint8_t out[2];
+  Subsample420(plane, 4, 2, out);
+  EXPECT_EQ(out[0], 4);
+  EXPECT_EQ(out[1], 10);
+}
+
+}  // namespace
+}  // namespace Capture
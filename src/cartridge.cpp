@@ -6,38 +6,46 @@
 #include <string>
 #include <iostream>
 #include <utility>
+#include <variant>
+#include "cartridge.h"
 #include "mapper.h"
+#include "memory_arena.h"
 #include "mappers/mbc1.h"
 #include "mappers/mbc3.h"
 
 namespace Cartridge {
 
 uint8_t *data;
-Mapper* mapper;
-int ram_size_bytes;
+Header header;
+std::optional<MapperVariant> mapper;
 std::string save_path;
 
 uint8_t read(uint16_t addr) {
-  return mapper->read(addr);
+  return std::visit([addr](auto &m) { return m.read(addr); }, *mapper);
 }
 
 uint8_t write(uint16_t addr, uint8_t val) {
-  return mapper->write(addr, val);
+  return std::visit([addr, val](auto &m) { return m.write(addr, val); }, *mapper);
 }
 
 uint8_t get_bank(uint16_t addr) {
-  return mapper->get_bank(addr);
+  return std::visit([addr](auto &m) { return m.get_bank(addr); }, *mapper);
+}
+
+const uint8_t* get_host_ptr(uint16_t addr) {
+  return std::visit([addr](auto &m) { return m.get_host_ptr(addr); }, *mapper);
 }
 
 void Save() {
-  uint8_t* ram = mapper->get_ram();
+  uint8_t* ram = std::visit([](auto &m) { return m.get_ram(); }, *mapper);
   FILE *file = fopen(save_path.c_str(), "wb");
   if (file == nullptr) {
     std::cerr << "failed to open the save file" << std::endl;
+    return;
   }
 
-  size_t bytes_written = fwrite(ram, 1, ram_size_bytes, file);
-  if (bytes_written < ram_size_bytes) {
+  size_t bytes_written = fwrite(ram, 1, header.ram_size_bytes, file);
+  if (bytes_written < static_cast<size_t>(header.ram_size_bytes)) {
     exit(1);
   }
   printf("I wrote to file! %s\n", save_path.c_str());
@@ -52,25 +60,127 @@ void SavePath(std::string path) {
   save_path = save_path + ".sav";
 }
 
-void SetRamSize(int size) {
-  switch (size) {
+int RamSizeBytes(uint8_t ram_size) {
+  switch (ram_size) {
+    case 0:
+      return 0;
+    case 2:
+      return 0x2000;
+    case 3:
+      return 0x8000;
+    case 4:
+      return 0x20000;
+    case 5:
+      return 0x10000;
+    default:
+      return -1;
+  }
+}
+
+// Largest $0148 ROM size code each mapper can bank.
+int MaxRomSize(uint8_t cartridge_type) {
+  switch (cartridge_type) {
+    case 0:
+      return 0;
+    case 1:
+    case 2:
+    case 3:
+      return 4;
+    case 0x0F:
+    case 0x10:
+    case 0x11:
+    case 0x12:
+    case 0x13:
+    case 0x1b:  //TODO: make MBC 5 for this
+      return 6;
+    default:
+      return -1;
+  }
+}
+
+std::optional<Header> ParseHeader(const uint8_t *rom, size_t size) {
+  if (size < 0x8000) {
+    std::cerr << "ROM is too small to be a cartridge: " << size << " bytes" << std::endl;
+    return std::nullopt;
+  }
+  Header h{};
+  h.cgb_support = rom[0x143] & 0x80;
+  h.cgb_only = rom[0x143] == 0xC0;
+  // CGB games use the end of the title for the manufacturer code and flag.
+  int title_length = h.cgb_support ? 11 : 16;
+  for (int i = 0; i < title_length && rom[0x134 + i] != 0; ++i) {
+    h.title += (char) rom[0x134 + i];
+  }
+  h.cartridge_type = rom[0x147];
+  h.rom_size = rom[0x148];
+  h.ram_size = rom[0x149];
+  h.header_checksum = rom[0x14D];
+  h.global_checksum = (rom[0x14E] << 8) | rom[0x14F];
+
+  uint8_t checksum = 0;
+  for (int i = 0x134; i <= 0x14C; ++i) {
+    checksum = checksum - rom[i] - 1;
+  }
+  h.header_checksum_valid = checksum == h.header_checksum;
+  uint16_t global_checksum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (i != 0x14E && i != 0x14F) {
+      global_checksum += rom[i];
+    }
+  }
+  h.global_checksum_valid = global_checksum == h.global_checksum;
+
+  int max_rom_size = MaxRomSize(h.cartridge_type);
+  if (max_rom_size < 0) {
+    std::cerr << "mapper type not supported: Mapper 0x" << std::hex << (int) h.cartridge_type << std::dec << std::endl;
+    return std::nullopt;
+  }
+  if (h.rom_size > max_rom_size) {
+    std::cerr << "ROM size code 0x" << std::hex << (int) h.rom_size << " not supported for mapper 0x"
+              << (int) h.cartridge_type << std::dec << std::endl;
+    return std::nullopt;
+  }
+  h.rom_size_bytes = 0x8000 << h.rom_size;
+  if (size < static_cast<size_t>(h.rom_size_bytes)) {
+    std::cerr << "ROM is truncated, header says " << h.rom_size_bytes << " bytes but file has "
+              << size << std::endl;
+    return std::nullopt;
+  }
+  h.ram_size_bytes = RamSizeBytes(h.ram_size);
+  if (h.ram_size_bytes < 0 || h.ram_size_bytes > static_cast<int>(sizeof(Memory::Arena::cart_ram))) {
+    std::cerr << "RAM size code 0x" << std::hex << (int) h.ram_size << std::dec << " not supported" << std::endl;
+    return std::nullopt;
+  }
+  return h;
+}
+
+MapperVariant CreateMapper(const Header &h, uint8_t *rom, uint8_t *ram) {
+  switch (h.cartridge_type) {
+    case 1:
+    case 2:
     case 3:
-      ram_size_bytes = 0x8000;
-      break;
+      return MapperVariant(std::in_place_type<MBC1>, rom, ram, h.rom_size, h.ram_size);
+    case 0x0F:
+    case 0x10:
+    case 0x11:
+    case 0x12:
+    case 0x13:
+    case 0x1b:
+      return MapperVariant(std::in_place_type<MBC3>, rom, ram, h.rom_size, h.ram_size);
     default:
-      ram_size_bytes = 0;
+      return MapperVariant(std::in_place_type<Mapper>, rom);
   }
 }
 
 bool IsCgbMode() {
-  return data[0x143] & 0x80;
+  return header.cgb_support;
 }
 
 uint8_t* GetRam() {
-  if (ram_size_bytes == 0) {
+  if (header.ram_size_bytes == 0) {
     return nullptr;
   }
-  auto* ram = new uint8_t[ram_size_bytes];
+  uint8_t* ram = Memory::arena.cart_ram;
 
   FILE* file = fopen(save_path.c_str(), "rb");
   if (file == nullptr) {
@@ -78,19 +188,21 @@ uint8_t* GetRam() {
     return ram;
   }
 
-  size_t bytes_read = fread(ram, 1, ram_size_bytes, file);
-  if (bytes_read  < ram_size_bytes) {
+  size_t bytes_read = fread(ram, 1, header.ram_size_bytes, file);
+  if (bytes_read < static_cast<size_t>(header.ram_size_bytes)) {
     std::cerr << "Failed to read from the file with error code" << std::endl;
     exit(2);
   }
+  fclose(file);
   return ram;
 }
 
-void load_cartridge(const char *file_path) {
+bool load_cartridge(const char *file_path) {
   SavePath(std::string(file_path));
   FILE *file = fopen(file_path, "rb");
   if (file == nullptr) {
     std::cerr << "failed to open the cartridge ROM" << std::endl;
+    return false;
   }
   fseek(file, 0, SEEK_END);
   size_t size = ftell(file);
@@ -98,40 +210,38 @@ void load_cartridge(const char *file_path) {
 
   data = new uint8_t[size];
   size_t bytes_read = fread(data, 1, size, file);
+  fclose(file);
   if (bytes_read  < size) {
     std::cerr << "Failed to read from the file with error code" << std::endl;
-    exit(2);
+    return false;
   }
 
-  int cartride_type = data[0x147];
-  int rom_size = data[0x148];
-  int ram_size = data[0x149];
-  SetRamSize(ram_size);
+  std::optional<Header> parsed = ParseHeader(data, size);
+  if (!parsed) {
+    return false;
+  }
+  header = *parsed;
+  if (!header.header_checksum_valid) {
+    std::cerr << "warning: header checksum does not match" << std::endl;
+  }
 
   uint8_t* ram = GetRam();
+  mapper.emplace(CreateMapper(header, data, ram));
 
-  switch (cartride_type) {
-    case 0:
-      mapper = new Mapper(data);
-      break;
-    case 1:
-    case 2:
-    case 3:
-      mapper = new MBC1(data, ram, rom_size, ram_size);
-      break;
-    case 0x10:
-    case 0x1b:  //TODO: make MBC 5 for this
-    case 0x13:
-      mapper = new MBC3(data, ram, rom_size, ram_size);
-      break;
-    default:
-      std::cerr << "mapper type not supported: Mapper " << cartride_type << std::endl;
-  }
-
+  std::cout << "title is " << header.title << std::endl;
+  std::cout << "the cartridge type is " << std::hex << (int) header.cartridge_type << std::endl;
+  std::cout << "rom size is " << std::hex << (int) header.rom_size << std::endl;
+  std::cout << "ram size is " << std::hex << (int) header.ram_size << std::dec << std::endl;
+  return true;
+}
 
-  std::cout << "the cartridge type is " << std::hex << cartride_type << std::endl;
-  std::cout << "rom size is " << std::hex << rom_size << std::endl;
-  std::cout << "ram size is " << std::hex << ram_size << std::endl;
+std::optional<MapperVariant> SaveMapper() {
+  return mapper;
+}
 
+void LoadMapper(const MapperVariant& saved) {
+  // The mapper only points into the ROM and the arena, which stay where they
+  // are, so a copy is all the state there is.
+  mapper.emplace(saved);
 }
 }  // namespace Cartridge
@@ -6,11 +6,42 @@
 #define GB_EMU_SRC_CARTRIDGE_H_
 
 #include <string>
+#include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <variant>
 #include "cpu.h"
+#include "mapper.h"
+#include "mappers/mbc1.h"
+#include "mappers/mbc3.h"
 
 namespace Cartridge {
 
+using MapperVariant = std::variant<Mapper, MBC1, MBC3>;
+
+// Cartridge header found at 0x0100-0x014F of every ROM.
+struct Header {
+  std::string title;
+  // $0147, which mapper and extra hardware the cartridge has.
+  uint8_t cartridge_type;
+  // $0148 and $0149 size codes.
+  uint8_t rom_size;
+  uint8_t ram_size;
+  int rom_size_bytes;
+  int ram_size_bytes;
+  // $0143, bit 7 set when the game supports CGB functions, 0xC0 if CGB only.
+  bool cgb_support;
+  bool cgb_only;
+  uint8_t header_checksum;
+  uint16_t global_checksum;
+  bool header_checksum_valid;
+  bool global_checksum_valid;
+};
+
+// Parse and validate the header of a ROM image. Returns std::nullopt and
+// reports why when the image can not be emulated.
+std::optional<Header> ParseHeader(const uint8_t* rom, size_t size);
+
 uint8_t read(uint16_t addr);
 uint8_t write(uint16_t addr, uint8_t val);
 
@@ -20,7 +51,17 @@ bool IsCgbMode();
 
 uint8_t get_bank(uint16_t addr);
 
-void load_cartridge(const char* file_path);
+// Host memory backing addr, valid to the end of its 0x1000 byte page.
+const uint8_t* get_host_ptr(uint16_t addr);
+
+// Load the ROM and create its mapper, returns false if it can not be run.
+bool load_cartridge(const char* file_path);
+
+// The mapper with its bank selects, for save states. Empty before a cartridge
+// is loaded.
+std::optional<MapperVariant> SaveMapper();
+// Put back a mapper saved from the cartridge that is loaded now.
+void LoadMapper(const MapperVariant& saved);
 
 }  // namespace Cartridge
 
@@ -0,0 +1,85 @@
+//
+// Created by Brian Bonafilia on 1/8/25.
+//
+
+#include "cartridge.h"
+
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace Cartridge {
+namespace {
+
+// A blank ROM of size bytes with the given header fields and a correct
+// header checksum.
+std::vector<uint8_t> MakeRom(size_t size, uint8_t type, uint8_t rom_size, uint8_t ram_size) {
+  std::vector<uint8_t> rom(size);
+  const char title[] = "TESTROM";
+  std::copy(title, title + sizeof(title) - 1, rom.begin() + 0x134);
+  rom[0x147] = type;
+  rom[0x148] = rom_size;
+  rom[0x149] = ram_size;
+  uint8_t checksum = 0;
+  for (int i = 0x134; i <= 0x14C; ++i) {
+    checksum = checksum - rom[i] - 1;
+  }
+  rom[0x14D] = checksum;
+  return rom;
+}
+
+TEST(ParseHeader, ValidMbc1) {
+  std::vector<uint8_t> rom = MakeRom(0x20000, 0x03, 2, 3);
+  std::optional<Header> header = ParseHeader(rom.data(), rom.size());
+  ASSERT_TRUE(header);
+  EXPECT_EQ(header->title, "TESTROM");
+  EXPECT_EQ(header->cartridge_type, 0x03);
+  EXPECT_EQ(header->rom_size_bytes, 0x20000);
+  EXPECT_EQ(header->ram_size_bytes, 0x8000);
+  EXPECT_TRUE(header->header_checksum_valid);
+  EXPECT_FALSE(header->cgb_support);
+}
+
+TEST(ParseHeader, RejectsUnsupportedMapper) {
+  // MBC5 with rumble.
+  std::vector<uint8_t> rom = MakeRom(0x8000, 0x1C, 0, 0);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+}
+
+TEST(ParseHeader, RejectsRomSizeTheMapperCanNotBank) {
+  // MBC1 banks up to 512 KiB, code 4.
+  std::vector<uint8_t> rom = MakeRom(0x100000, 0x01, 5, 0);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+  // no mapper, only 32 KiB.
+  rom = MakeRom(0x10000, 0x00, 1, 0);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+}
+
+TEST(ParseHeader, RejectsTruncatedFiles) {
+  // the header says 128 KiB.
+  std::vector<uint8_t> rom = MakeRom(0x20000, 0x01, 2, 0);
+  EXPECT_FALSE(ParseHeader(rom.data(), 0x18000));
+  // not even the two fixed banks.
+  EXPECT_FALSE(ParseHeader(rom.data(), 0x4000));
+}
+
+TEST(ParseHeader, BadHeaderChecksumIsOnlyFlagged) {
+  std::vector<uint8_t> rom = MakeRom(0x8000, 0x00, 0, 0);
+  rom[0x14D] ^= 0xFF;
+  std::optional<Header> header = ParseHeader(rom.data(), rom.size());
+  ASSERT_TRUE(header);
+  EXPECT_FALSE(header->header_checksum_valid);
+}
+
+TEST(ParseHeader, RejectsRamSizesThatDoNotFit) {
+  // 128 KiB, more than cart_ram holds.
+  std::vector<uint8_t> rom = MakeRom(0x8000, 0x03, 0, 4);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+  // code 1 is unused.
+  rom = MakeRom(0x8000, 0x03, 0, 1);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+  rom = MakeRom(0x8000, 0x03, 0, 0xFF);
+  EXPECT_FALSE(ParseHeader(rom.data(), rom.size()));
+}
+
+}  // namespace
+}  // namespace Cartridge
@@ -11,6 +11,7 @@
 #include "ppu.h"
 #include "cartridge.h"
 #include "gui.h"
+#include "memory_arena.h"
 #include "debug/log.h"
 
 namespace CPU {
@@ -20,12 +21,13 @@ bool debug = false;
 int tick_count = 0;
 
 Registers registers;
-uint8_t **reg_ind = new uint8_t *[7];
-uint16_t **reg_16ind = new uint16_t *[4];
-// start with 8KiB, will have to update to support GBC banking later
-uint8_t *wram = new uint8_t[0x8000];
-uint8_t *hram = new uint8_t[0x7E];
-uint8_t *serial_port = new uint8_t[0x2];
+uint8_t *reg_ind[7];
+uint16_t *reg_16ind[4];
+uint8_t *const wram = Memory::arena.wram;
+// WRAM bank currently mapped at 0xD000, only updated on writes to 0xFF70.
+uint8_t *wram_bank_base = wram + 0x1000;
+uint8_t *const hram = Memory::arena.hram;
+uint8_t *const serial_port = Memory::arena.serial_port;
 
 bool next_op_ready = false;
 
@@ -33,10 +35,64 @@ bool next_op_ready = false;
 constexpr int kTotalCycles = 17556;
 constexpr int kDoubleSpeedCycles = 35112;
 int remaining_cycles = 0;
+uint64_t clock_cycles = 0;
 int serial_interrupt_counter = 0;
+int stall_cycles = 0;
+bool cgb_mode = false;
+// Mirrors LCDC bit 7, the PPU is only clocked while it is set.
+bool ppu_enabled = true;
+
+// OAM DMA copies everything when it starts, but the bus stays busy for the
+// 160 M-cycles the transfer takes on hardware.
+constexpr int kOamDmaCycles = 0xA0;
+int oam_dma_cycles = 0;
+uint16_t oam_dma_source = 0;
+
+enum Bus {
+  external_bus,
+  work_ram_bus,
+  video_bus,
+  internal_bus
+};
 
 bool found_break = false;
 uint16_t next_break = 0xC6A0;
+
+void SetWramBank(uint8_t val) {
+  registers.wram_bank = val;
+  int bank = val & 0x7;
+  // bank 0 selects bank 1 as well.
+  if (bank == 0) {
+    bank = 1;
+  }
+  wram_bank_base = wram + bank * 0x1000;
+}
+
+Bus GetBus(uint16_t addr) {
+  switch (addr) {
+    case 0x8000 ... 0x9FFF:
+      return video_bus;
+    case 0xC000 ... 0xFDFF:
+      // CGB has work RAM on its own bus, on DMG it shares the cartridge bus.
+      return cgb_mode ? work_ram_bus : external_bus;
+    case 0xFE00 ... 0xFFFF:
+      return internal_bus;
+    default:
+      return external_bus;
+  }
+}
+
+// Whether a CPU access to addr runs into an OAM DMA in progress.
+bool OamDmaConflict(uint16_t addr) {
+  if (oam_dma_cycles == 0 || addr >= 0xFF00) {
+    return false;
+  }
+  if (addr >= 0xFE00) {
+    // OAM itself is owned by the DMA.
+    return true;
+  }
+  return GetBus(addr) == GetBus(oam_dma_source);
+}
 }  //  namespace
 
 template<mode m>
@@ -69,15 +125,10 @@ uint8_t access(uint16_t addr, uint8_t val) {
       }
       return wram[addr - 0xC000];
     case 0xD000 ... 0xDFFF:
-      addr = addr - 0xD000 + ((registers.wram_bank & 0x7) * 0x1000);
-      if (registers.wram_bank == 0) {
-        addr += 0x1000;
-      }
-      assert(addr < 0x8000);
       if (m == write) {
-        wram[addr] = val;
+        wram_bank_base[addr - 0xD000] = val;
       }
-      return wram[addr];
+      return wram_bank_base[addr - 0xD000];
     case 0xE000 ... 0xFDFF:
       printf("testing?\n");
       // Not supposed to go here
@@ -146,7 +197,7 @@ uint8_t access(uint16_t addr, uint8_t val) {
       return PPU::access_registers(m, addr, val);
     case 0xFF70:
       if (m == write) {
-        registers.wram_bank = val;
+        SetWramBank(val);
         if (debug) {
           printf("writing to wram val %X\n", val);
         }
@@ -170,6 +221,20 @@ uint8_t access(uint16_t addr, uint8_t val) {
   return 0;
 }
 
+const uint8_t* ResolveReadPage(uint16_t addr) {
+  switch (addr) {
+    case 0x0000 ... 0x7FFF:
+    case 0xA000 ... 0xBFFF:
+      return Cartridge::get_host_ptr(addr);
+    case 0xC000 ... 0xCFFF:
+      return wram + (addr - 0xC000);
+    case 0xD000 ... 0xDFFF:
+      return wram_bank_base + (addr - 0xD000);
+    default:
+      return nullptr;
+  }
+}
+
 uint8_t imm8() {
   uint8_t val = rd8(registers.PC++);
   return val;
@@ -181,20 +246,36 @@ uint16_t imm16() {
   return val;
 }
 
+// Read through the CPU bus. On a conflict with OAM DMA the CPU sees the byte
+// the DMA is currently moving, or 0xFF for OAM.
+uint8_t BusRead(uint16_t addr) {
+  if (OamDmaConflict(addr)) {
+    if (addr >= 0xFE00) {
+      return 0xFF;
+    }
+    return access<read>(oam_dma_source + kOamDmaCycles - oam_dma_cycles);
+  }
+  return access<read>(addr);
+}
+
 uint16_t rd16(uint16_t addr) {
   Tick();
   Tick();
-  return access<read>(addr) | (access<read>(addr + 1) << 8);
+  return BusRead(addr) | (BusRead(addr + 1) << 8);
 }
 
 uint8_t rd8(uint16_t addr) {
   Tick();
-  return access<read>(addr);
+  return BusRead(addr);
 }
 
 uint8_t wr8(uint16_t addr, uint8_t val) {
 //  printf("Writing  0x%X to 0x%X \n", val, addr);
   Tick();
+  if (OamDmaConflict(addr)) {
+    // the DMA owns the bus, the write is lost.
+    return val;
+  }
   return access<write>(addr, val);
 }
 
@@ -208,11 +289,17 @@ void CheckTimer() {
 
 // TODO: evaluate running 4 M-cycles instead of one 4 cycle tick.
 void Tick() {
-  PPU::dot();
-  PPU::dot();
-  if (!registers.double_speed_mode) {
+  if (ppu_enabled) {
     PPU::dot();
     PPU::dot();
+    if (!registers.double_speed_mode) {
+      PPU::dot();
+      PPU::dot();
+    }
+  }
+  clock_cycles += registers.double_speed_mode ? 2 : 4;
+  if (oam_dma_cycles > 0) {
+    --oam_dma_cycles;
   }
   registers.time_counter++;
   if (registers.time_counter % 64 == 0) {
@@ -259,6 +346,7 @@ void Tick() {
 }
 
 void InitializeRegisters(bool cgb_mode) {
+  CPU::cgb_mode = cgb_mode;
   PPU::set_cgb_mode(cgb_mode);
   // CPU registers
   registers.A = cgb_mode ? 0x11 : 0x1;
@@ -286,6 +374,10 @@ void InitializeRegisters(bool cgb_mode) {
   registers.IME = false;
   registers.halt = false;
 
+  // no DMA from before is still holding the CPU.
+  stall_cycles = 0;
+  oam_dma_cycles = 0;
+
   reg_ind[0] = &registers.B;
   reg_ind[1] = &registers.C;
   reg_ind[2] = &registers.D;
@@ -299,6 +391,7 @@ void InitializeRegisters(bool cgb_mode) {
   reg_16ind[2] = &registers.HL;
   reg_16ind[3] = &registers.SP;
 
+  APU::Reset();
 };
 
 uint8_t **GetRegIndex() {
@@ -837,6 +930,11 @@ uint8_t getNextOp() {
 }
 
 void ProcessInstruction(bool debug) {
+  if (stall_cycles > 0) {
+    --stall_cycles;
+    Tick();
+    return;
+  }
   SetControllerState();
   if ((registers.IE & registers.IF) > 0) {
     registers.halt = false;
@@ -1165,6 +1263,10 @@ void ProcessInstruction(bool debug) {
   }
 }
 
+uint64_t Clock() {
+  return clock_cycles;
+}
+
 bool Halted() {
   return registers.halt;
 }
@@ -1173,5 +1275,45 @@ void SetDoubleSpeed(bool double_speed) {
   registers.double_speed_mode = double_speed;
 }
 
+void SetPpuEnabled(bool enabled) {
+  ppu_enabled = enabled;
+}
+
+void Stall(int cycles) {
+  stall_cycles += cycles;
+}
+
+void StartOamDma(uint16_t source) {
+  oam_dma_source = source;
+  oam_dma_cycles = kOamDmaCycles;
+}
+
+bool OamDmaActive() {
+  return oam_dma_cycles > 0;
+}
+
+void SaveState(Registers* registers_out, Internals* internals_out) {
+  *registers_out = registers;
+  *internals_out = {
+      .remaining_cycles = remaining_cycles,
+      .serial_interrupt_counter = serial_interrupt_counter,
+      .stall_cycles = stall_cycles,
+      .oam_dma_cycles = oam_dma_cycles,
+      .oam_dma_source = oam_dma_source,
+      .ppu_enabled = ppu_enabled,
+  };
+}
+
+void LoadState(const Registers& saved_registers, const Internals& saved_internals) {
+  registers = saved_registers;
+  SetWramBank(registers.wram_bank);
+  remaining_cycles = saved_internals.remaining_cycles;
+  serial_interrupt_counter = saved_internals.serial_interrupt_counter;
+  stall_cycles = saved_internals.stall_cycles;
+  oam_dma_cycles = saved_internals.oam_dma_cycles;
+  oam_dma_source = saved_internals.oam_dma_source;
+  ppu_enabled = saved_internals.ppu_enabled;
+}
+
 }  //  namespace CPU
 
@@ -142,6 +142,11 @@ uint8_t rd8(uint16_t addr);
 uint16_t rd16(uint16_t addr);
 uint8_t wr8(uint16_t addr, uint8_t val);
 
+// Resolve addr to the host memory backing it for reads. The returned pointer
+// is valid up to the end of the 0x1000 byte page containing addr, or nullptr
+// when the address is not backed by plain memory.
+const uint8_t* ResolveReadPage(uint16_t addr);
+
 // Power up sequence initialize registers;
 void InitializeRegisters(bool cgb_mode = false);
 
@@ -150,6 +155,10 @@ void ProcessInstruction(bool debug = false);
 
 void Tick();
 
+// T-cycles of the normal speed clock since power up. In double speed mode an
+// M-cycle is 2 of them instead of 4.
+uint64_t Clock();
+
 bool Halted();
 
 // approximation of running about a frame worth of cycles.
@@ -157,6 +166,34 @@ void RunFrame(bool debug);
 
 void SetDoubleSpeed(bool double_speed);
 
+// Keep the CPU from executing for the given number of M-cycles, used by DMA.
+void Stall(int cycles);
+
+// Open the 160 M-cycle OAM DMA window for a transfer from source. While it is
+// open the CPU bus only reaches HRAM and I/O registers without conflicts.
+void StartOamDma(uint16_t source);
+
+bool OamDmaActive();
+
+// Attach or detach the PPU from the clock. While the LCD is off the PPU has
+// nothing to do and is not stepped at all.
+void SetPpuEnabled(bool enabled);
+
+// CPU state kept outside of Registers that a save state has to carry along.
+struct Internals {
+  int remaining_cycles;
+  int serial_interrupt_counter;
+  int stall_cycles;
+  int oam_dma_cycles;
+  uint16_t oam_dma_source;
+  bool ppu_enabled;
+};
+
+void SaveState(Registers* registers_out, Internals* internals_out);
+// Restore a saved CPU and map the WRAM bank it had selected. Clock() keeps
+// counting from where it is so everything timed against it stays valid.
+void LoadState(const Registers& saved_registers, const Internals& saved_internals);
+
 }
 
   // namespace CPU
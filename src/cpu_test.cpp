@@ -1,6 +1,7 @@
 //
 // Created by Brian Bonafilia on 9/10/24.
 //
+#include <initializer_list>
 #include <gtest/gtest.h>
 #include "cpu.h"
 
@@ -77,5 +78,66 @@ TEST(CpuTest, ReadInstruction) {
 
 }
 
+// DMG with an OAM DMA source at 0xC000, a marker byte elsewhere on the same
+// bus and one in HRAM, and program loaded at 0xFF80 to run from HRAM like
+// games do during the transfer.
+void SetUpOamDma(std::initializer_list<uint8_t> program) {
+  InitializeRegisters(false);
+  access<write>(0xFFFF, 0);
+  for (int i = 0; i < 0xA0; ++i) {
+    access<write>(0xC000 + i, 0x10 + i);
+  }
+  access<write>(0xD000, 0x55);
+  access<write>(0xFF90, 0x77);
+  uint16_t addr = 0xFF80;
+  for (uint8_t byte : program) {
+    access<write>(addr++, byte);
+  }
+  GetRegisters().PC = 0xFF80;
+  access<write>(0xFF46, 0xC0);
+}
+
+TEST(OamDma, ConflictingAccessesHitTheDmaByte) {
+  SetUpOamDma({
+      0xFA, 0x00, 0xD0,  // LD A, [0xD000]
+      0xF0, 0x90,        // LDH A, [0x90]
+      0xFA, 0x00, 0xFE,  // LD A, [0xFE00]
+      0xEA, 0x00, 0xD0,  // LD [0xD000], A
+  });
+  ASSERT_TRUE(OamDmaActive());
+  // WRAM shares the external bus with the source on DMG. The read is the
+  // 4th M-cycle of the transfer, so it sees the 5th byte being moved.
+  ProcessInstruction();
+  EXPECT_EQ(GetRegisters().A, 0x10 + 4);
+  // HRAM has a bus of its own.
+  ProcessInstruction();
+  EXPECT_EQ(GetRegisters().A, 0x77);
+  // OAM belongs to the DMA.
+  ProcessInstruction();
+  EXPECT_EQ(GetRegisters().A, 0xFF);
+  // and a write on the busy bus is lost.
+  ProcessInstruction();
+  EXPECT_TRUE(OamDmaActive());
+  EXPECT_EQ(access<read>(0xD000), 0x55);
+}
+
+TEST(OamDma, ConflictEndsAfter160Cycles) {
+  SetUpOamDma({
+      0x18, 0xFE,        // JR -2
+      0xFA, 0x00, 0xD0,  // LD A, [0xD000]
+  });
+  uint64_t start = Clock();
+  while (OamDmaActive()) {
+    ProcessInstruction();
+  }
+  EXPECT_GE(Clock() - start, 160u * 4);
+  // the loop's 3 M-cycles overshoot the end by at most 2.
+  EXPECT_LE(Clock() - start, 162u * 4);
+  GetRegisters().PC = 0xFF82;
+  ProcessInstruction();
+  EXPECT_EQ(GetRegisters().A, 0x55);
+  EXPECT_EQ(access<read>(0xFE00), 0x10);
+}
+
 }
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+//
+// Created by Brian Bonafilia on 1/4/25.
+//
+
+#ifndef GB_EMU_SRC_DEBUG_FRAME_HASH_H_
+#define GB_EMU_SRC_DEBUG_FRAME_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Debug {
+
+// XXH64 of length bytes, matching the reference implementation on little
+// endian hosts.
+uint64_t Xxh64(const void* data, size_t length, uint64_t seed = 0);
+
+// Hash of a finished 160x144 RGB888 frame.
+uint64_t HashFrame(const uint32_t* pixels);
+
+// Write a 160x144 RGB888 frame as a binary PPM, false on failure.
+bool WritePpm(const char* path, const uint32_t* pixels);
+
+}  // namespace Debug
+
+#endif //GB_EMU_SRC_DEBUG_FRAME_HASH_H_
@@ -0,0 +1,167 @@
+//
+// Created by Brian Bonafilia on 1/4/25.
+//
+
+#include "golden.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "frame_hash.h"
+#include "../cpu.h"
+#include "../gui.h"
+#include "../ppu_worker.h"
+#include "../rendering/draw.h"
+
+namespace Debug {
+
+namespace {
+
+// A game can keep the LCD off, and draw nothing, for a while.
+constexpr int kMaxEmulatedPerDrawn = 4;
+
+struct Button {
+  const char *name;
+  bool direction;
+  uint8_t bit;
+};
+
+// Same bit layout as CPU::Joypad.
+constexpr Button kButtons[]{
+    {"A", false, 0x1}, {"B", false, 0x2}, {"SELECT", false, 0x4}, {"START", false, 0x8},
+    {"RIGHT", true, 0x1}, {"LEFT", true, 0x2}, {"UP", true, 0x4}, {"DOWN", true, 0x8},
+};
+
+/* State of the run in progress, for the frame observer */
+GoldenResult *run_result = nullptr;
+const std::vector<uint64_t> *run_golden = nullptr;
+const char *run_ppm_path = nullptr;
+size_t run_frames = 0;
+
+void CheckFrame(const uint32_t *pixels) {
+  if (run_result->first_divergence >= 0 || run_result->hashes.size() == run_frames) {
+    return;
+  }
+  uint64_t hash = HashFrame(pixels);
+  size_t frame = run_result->hashes.size();
+  run_result->hashes.push_back(hash);
+  if (run_golden == nullptr || frame >= run_golden->size() || (*run_golden)[frame] == hash) {
+    return;
+  }
+  run_result->first_divergence = frame;
+  printf("frame %zu diverges: expected %016" PRIx64 ", got %016" PRIx64 "\n", frame, (*run_golden)[frame], hash);
+  if (run_ppm_path != nullptr) {
+    if (WritePpm(run_ppm_path, pixels)) {
+      printf("wrote frame %zu to %s\n", frame, run_ppm_path);
+    } else {
+      fprintf(stderr, "failed to write %s\n", run_ppm_path);
+    }
+  }
+}
+
+}  // namespace
+
+bool ParseMovie(const std::string &text, Movie &movie) {
+  movie.clear();
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    MovieInput input{.frame = 0, .actions = 0xF, .directions = 0xF};
+    if (!(words >> input.frame)) {
+      if (line.find_first_not_of(" \t\r") != std::string::npos) {
+        fprintf(stderr, "bad movie line: %s\n", line.c_str());
+        return false;
+      }
+      continue;
+    }
+    std::string word;
+    while (words >> word) {
+      bool known = false;
+      for (const Button &button : kButtons) {
+        if (word == button.name) {
+          (button.direction ? input.directions : input.actions) &= ~button.bit;
+          known = true;
+        }
+      }
+      if (!known) {
+        fprintf(stderr, "unknown button %s\n", word.c_str());
+        return false;
+      }
+    }
+    if (!movie.empty() && input.frame < movie.back().frame) {
+      fprintf(stderr, "movie frames out of order at %d\n", input.frame);
+      return false;
+    }
+    movie.push_back(input);
+  }
+  return true;
+}
+
+bool LoadMovie(const char *path, Movie &movie) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "failed to open movie %s\n", path);
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  return ParseMovie(text.str(), movie);
+}
+
+bool LoadGolden(const char *path, std::vector<uint64_t> &hashes) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  hashes.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty()) {
+      hashes.push_back(std::stoull(line, nullptr, 16));
+    }
+  }
+  return true;
+}
+
+bool SaveGolden(const char *path, const std::vector<uint64_t> &hashes) {
+  FILE *file = fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  for (uint64_t hash : hashes) {
+    fprintf(file, "%016" PRIx64 "\n", hash);
+  }
+  return fclose(file) == 0;
+}
+
+GoldenResult RunGolden(const Movie &movie, int frames, const std::vector<uint64_t> *golden, const char *ppm_path) {
+  GoldenResult result;
+  run_result = &result;
+  run_golden = golden;
+  run_ppm_path = ppm_path;
+  run_frames = frames;
+  PPU::SetFrameObserver(CheckFrame);
+
+  size_t next_input = 0;
+  for (int emulated = 0; emulated < frames * kMaxEmulatedPerDrawn; ++emulated) {
+    while (next_input < movie.size() && movie[next_input].frame <= emulated) {
+      GUI::SetButtons(movie[next_input].actions, movie[next_input].directions);
+      ++next_input;
+    }
+    CPU::RunFrame(false);
+    // the pipelined renderer draws on its own thread.
+    PPU::FlushWorker();
+    if (result.hashes.size() >= static_cast<size_t>(frames) || result.first_divergence >= 0) {
+      break;
+    }
+  }
+
+  PPU::SetFrameObserver(nullptr);
+  run_result = nullptr;
+  return result;
+}
+
+}  // namespace Debug
@@ -0,0 +1,52 @@
+//
+// Created by Brian Bonafilia on 1/4/25.
+//
+
+#ifndef GB_EMU_SRC_DEBUG_GOLDEN_H_
+#define GB_EMU_SRC_DEBUG_GOLDEN_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Golden image regression runs: play the loaded cartridge headless with a
+// recorded input movie and compare the hash of every drawn frame against a
+// stored list.
+namespace Debug {
+
+// Buttons held from frame on, bits as in the joypad register, 0 is pressed.
+struct MovieInput {
+  int frame;
+  uint8_t actions;
+  uint8_t directions;
+};
+
+// Sorted by frame.
+using Movie = std::vector<MovieInput>;
+
+// One "<frame> <button>..." line per change, buttons out of A, B, SELECT,
+// START, UP, DOWN, LEFT and RIGHT. A line without buttons releases all of
+// them, # starts a comment.
+bool ParseMovie(const std::string& text, Movie& movie);
+bool LoadMovie(const char* path, Movie& movie);
+
+// One hex hash per line.
+bool LoadGolden(const char* path, std::vector<uint64_t>& hashes);
+bool SaveGolden(const char* path, const std::vector<uint64_t>& hashes);
+
+struct GoldenResult {
+  // Hash of every frame drawn, up to and including the first divergence.
+  std::vector<uint64_t> hashes;
+  // First frame whose hash is not the golden one, -1 if there was none.
+  int first_divergence = -1;
+};
+
+// Run the loaded cartridge until frames frames are drawn. Frames in the
+// movie count emulated frames. With golden, stop at the first frame that
+// differs from it and write that frame to ppm_path.
+GoldenResult RunGolden(const Movie& movie, int frames, const std::vector<uint64_t>* golden,
+                       const char* ppm_path);
+
+}  // namespace Debug
+
+#endif //GB_EMU_SRC_DEBUG_GOLDEN_H_
@@ -0,0 +1,115 @@
+//
+// Created by Brian Bonafilia on 1/4/25.
+//
+
+#include "golden.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
+#include <gtest/gtest.h>
+#include "frame_hash.h"
+#include "../cartridge.h"
+#include "../cpu.h"
+
+namespace Debug {
+namespace {
+
+// Reference values from the xxHash library.
+TEST(FrameHash, Xxh64) {
+  std::vector<uint8_t> bytes;
+  for (int i = 0; i < 100; ++i) {
+    bytes.push_back(i);
+  }
+  EXPECT_EQ(Xxh64("", 0), 0xEF46DB3751D8E999);
+  EXPECT_EQ(Xxh64("a", 1), 0xD24EC4F1A98C6E5B);
+  EXPECT_EQ(Xxh64(bytes.data(), bytes.size()), 0x6AC1E58032166597);
+  EXPECT_EQ(Xxh64(bytes.data(), bytes.size(), 1), 0x3D19A3A2098A7023);
+}
+
+TEST(Golden, ParseMovie) {
+  Movie movie;
+  ASSERT_TRUE(ParseMovie("# title screen\n10 START\n12\n\n30 A RIGHT  # jump\n", movie));
+  ASSERT_EQ(movie.size(), 3u);
+  EXPECT_EQ(movie[0].frame, 10);
+  EXPECT_EQ(movie[0].actions, 0x7);
+  EXPECT_EQ(movie[0].directions, 0xF);
+  EXPECT_EQ(movie[1].actions, 0xF);
+  EXPECT_EQ(movie[2].actions, 0xE);
+  EXPECT_EQ(movie[2].directions, 0xE);
+
+  EXPECT_FALSE(ParseMovie("5 TURBO\n", movie));
+  EXPECT_FALSE(ParseMovie("5 A\n4 B\n", movie));
+}
+
+TEST(Golden, SaveAndLoad) {
+  std::vector<uint64_t> hashes{0, 1, 0xFEDCBA9876543210};
+  const char *path = "golden_test.golden";
+  ASSERT_TRUE(SaveGolden(path, hashes));
+  std::vector<uint64_t> loaded;
+  ASSERT_TRUE(LoadGolden(path, loaded));
+  EXPECT_EQ(loaded, hashes);
+  remove(path);
+}
+
+// A ROM only cartridge that keeps rewriting all tile data, so every frame
+// looks different.
+void WriteTileLoopRom(const char *path) {
+  std::vector<uint8_t> rom(0x8000);
+  const uint8_t entry[]{0xC3, 0x50, 0x01};  // JP 0x150
+  const uint8_t program[]{
+      0x3E, 0xE4,        // LD A, 0xE4
+      0xE0, 0x47,        // LDH [BGP], A, the reset value shows nothing
+      0x21, 0x00, 0x80,  // LD HL, 0x8000
+      0x04,              // INC B, shifts the pattern every pass
+      0x04,              // INC B
+      0x78,              // LD A, B
+      0x22,              // LD [HL+], A
+      0x7C,              // LD A, H
+      0xFE, 0x98,        // CP 0x98
+      0x20, 0xF8,        // JR NZ, -8
+      0x18, 0xF2,        // JR -14
+  };
+  std::copy(std::begin(entry), std::end(entry), rom.begin() + 0x100);
+  std::copy(std::begin(program), std::end(program), rom.begin() + 0x150);
+  uint8_t checksum = 0;
+  for (int i = 0x134; i <= 0x14C; ++i) {
+    checksum = checksum - rom[i] - 1;
+  }
+  rom[0x14D] = checksum;
+  FILE *file = fopen(path, "wb");
+  fwrite(rom.data(), 1, rom.size(), file);
+  fclose(file);
+}
+
+TEST(Golden, ReportsFirstDivergence) {
+  const char *rom_path = "golden_test.gb";
+  const char *ppm_path = "golden_test.ppm";
+  WriteTileLoopRom(rom_path);
+  ASSERT_TRUE(Cartridge::load_cartridge(rom_path));
+  CPU::InitializeRegisters(false);
+
+  GoldenResult recorded = RunGolden({}, 20, nullptr, nullptr);
+  ASSERT_EQ(recorded.hashes.size(), 20u);
+  EXPECT_EQ(recorded.first_divergence, -1);
+  EXPECT_NE(recorded.hashes[5], recorded.hashes[15]);
+
+  // The next frames will not match, the first one gets reported and written.
+  std::vector<uint64_t> golden(10, recorded.hashes[0]);
+  GoldenResult checked = RunGolden({}, 10, &golden, ppm_path);
+  EXPECT_EQ(checked.first_divergence, 0);
+  EXPECT_EQ(checked.hashes.size(), 1u);
+
+  FILE *ppm = fopen(ppm_path, "rb");
+  ASSERT_NE(ppm, nullptr);
+  fseek(ppm, 0, SEEK_END);
+  EXPECT_EQ(ftell(ppm), static_cast<long>(strlen("P6\n160 144\n255\n") + 160 * 144 * 3));
+  fclose(ppm);
+  remove(ppm_path);
+  remove(rom_path);
+}
+
+}  // namespace
+}  // namespace Debug
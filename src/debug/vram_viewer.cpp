@@ -0,0 +1,157 @@
+//
+// Created by Brian Bonafilia on 12/30/24.
+//
+
+#include "vram_viewer.h"
+
+#include <algorithm>
+#include <cstring>
+#include "../triple_buffer.h"
+#include "../rendering/pixel_kernels.h"
+
+namespace Debug {
+
+namespace {
+
+constexpr int kMapOrigin[2][2]{{0, 0}, {256, 0}};
+constexpr int kTileDataOrigin[2][2]{{0, 256}, {128, 256}};
+constexpr int kOamOrigin[2]{256, 256};
+constexpr int kPaletteOrigin[2]{384, 256};
+// Tiles per row in the tile data view.
+constexpr int kTileColumns = 16;
+constexpr int kSwatchSize = 8;
+
+TripleBuffer<VramSnapshot> snapshots;
+
+// Same addressing as PPU::GetTileAddr for the LCDC in the snapshot.
+int TileIndex(uint8_t lcdc, uint8_t map_value) {
+  bool unsigned_addressing = lcdc & 0x10;
+  return unsigned_addressing ? map_value : 256 + static_cast<int8_t>(map_value);
+}
+
+void DrawDecodedTile(const uint8_t *decoded, const uint32_t *palette, bool flip_x, bool flip_y, uint32_t *out,
+                     int stride) {
+  for (int row = 0; row < 8; ++row) {
+    const uint8_t *src = decoded + (flip_y ? 7 - row : row) * 8;
+    uint32_t *dest = out + row * stride;
+    for (int col = 0; col < 8; ++col) {
+      dest[col] = palette[src[flip_x ? 7 - col : col]];
+    }
+  }
+}
+
+}  // namespace
+
+void PublishVramSnapshot(const PPU::PpuState &state) {
+  VramSnapshot &snapshot = snapshots.back();
+  memcpy(snapshot.vram[0], state.vram, sizeof(snapshot.vram[0]));
+  memcpy(snapshot.vram[1], state.vram_bank1, sizeof(snapshot.vram[1]));
+  memcpy(snapshot.oam, state.oam, sizeof(snapshot.oam));
+  memcpy(snapshot.palette_rgb, state.registers.palette_rgb, sizeof(snapshot.palette_rgb));
+  snapshot.lcdc = state.registers.LCDC;
+  snapshot.cgb_mode = state.registers.cgb_mode;
+  snapshots.Publish();
+}
+
+bool VramViewer::Update() {
+  if (!snapshots.Consume()) {
+    return false;
+  }
+  const VramSnapshot &snapshot = snapshots.front();
+  // Palettes and addressing touch every tile on screen, both change rarely.
+  bool redraw_all = !has_drawn_ || snapshot.lcdc != drawn_.lcdc || snapshot.cgb_mode != drawn_.cgb_mode
+      || memcmp(snapshot.palette_rgb, drawn_.palette_rgb, sizeof(snapshot.palette_rgb)) != 0;
+  DecodeChangedTiles(snapshot, redraw_all);
+  DrawTileData(snapshot, redraw_all);
+  DrawMaps(snapshot, redraw_all);
+  // 40 OBJs and 64 colors, cheaper to draw than to diff.
+  DrawOam(snapshot);
+  DrawPalettes(snapshot);
+  drawn_ = snapshot;
+  has_drawn_ = true;
+  return true;
+}
+
+void VramViewer::DecodeChangedTiles(const VramSnapshot &snapshot, bool redraw_all) {
+  for (int bank = 0; bank < 2; ++bank) {
+    for (int tile = 0; tile < PPU::kTilesPerBank; ++tile) {
+      const uint8_t *data = snapshot.vram[bank] + tile * 16;
+      bool changed = redraw_all || memcmp(data, drawn_.vram[bank] + tile * 16, 16) != 0;
+      tile_changed_[bank][tile] = changed;
+      if (changed) {
+        PPU::Kernels().decode_rows(data, 8, false, decoded_[bank][tile]);
+      }
+    }
+  }
+}
+
+void VramViewer::DrawTileData(const VramSnapshot &snapshot, bool redraw_all) {
+  for (int bank = 0; bank < 2; ++bank) {
+    for (int tile = 0; tile < PPU::kTilesPerBank; ++tile) {
+      if (!redraw_all && !tile_changed_[bank][tile]) {
+        continue;
+      }
+      int x = kTileDataOrigin[bank][0] + (tile % kTileColumns) * 8;
+      int y = kTileDataOrigin[bank][1] + (tile / kTileColumns) * 8;
+      DrawDecodedTile(decoded_[bank][tile], snapshot.palette_rgb, false, false, pixels_ + y * kViewerWidth + x,
+                      kViewerWidth);
+    }
+  }
+}
+
+void VramViewer::DrawMaps(const VramSnapshot &snapshot, bool redraw_all) {
+  for (int map = 0; map < 2; ++map) {
+    int map_offset = map ? 0x1C00 : 0x1800;
+    for (int cell = 0; cell < 32 * 32; ++cell) {
+      int idx = map_offset + cell;
+      PPU::BgWindowAttributes attrs{.attr = snapshot.cgb_mode ? snapshot.vram[1][idx] : uint8_t{0}};
+      int tile = TileIndex(snapshot.lcdc, snapshot.vram[0][idx]);
+      bool cell_changed = snapshot.vram[0][idx] != drawn_.vram[0][idx] || snapshot.vram[1][idx] != drawn_.vram[1][idx];
+      if (!redraw_all && !cell_changed && !tile_changed_[attrs.bank][tile]) {
+        continue;
+      }
+      int x = kMapOrigin[map][0] + (cell % 32) * 8;
+      int y = kMapOrigin[map][1] + (cell / 32) * 8;
+      DrawDecodedTile(decoded_[attrs.bank][tile], snapshot.palette_rgb + attrs.cgb_palette * 4, attrs.flip_x,
+                      attrs.flip_y, pixels_ + y * kViewerWidth + x, kViewerWidth);
+    }
+  }
+}
+
+void VramViewer::DrawOam(const VramSnapshot &snapshot) {
+  bool tall = snapshot.lcdc & 0x04;
+  for (int obj = 0; obj < 40; ++obj) {
+    const uint8_t *entry = snapshot.oam + obj * 4;
+    PPU::SpriteAttributes attrs{.attr = entry[3]};
+    int bank = snapshot.cgb_mode ? attrs.bank : 0;
+    int palette = snapshot.cgb_mode ? attrs.cgb_palette : attrs.dmg_palette;
+    const uint32_t *colors = snapshot.palette_rgb + PPU::kObjPaletteEntries + palette * 4;
+    int x = kOamOrigin[0] + (obj % 10) * 8;
+    int y = kOamOrigin[1] + (obj / 10) * 16;
+    int tile = tall ? entry[2] & 0xFE : entry[2];
+    for (int half = 0; half < 2; ++half) {
+      uint32_t *out = pixels_ + (y + half * 8) * kViewerWidth + x;
+      if (!tall && half == 1) {
+        for (int row = 0; row < 8; ++row) {
+          std::fill_n(out + row * kViewerWidth, 8, PPU::kBlack);
+        }
+        continue;
+      }
+      // a flipped 8x16 OBJ also swaps its two tiles.
+      int part = attrs.flip_y && tall ? 1 - half : half;
+      DrawDecodedTile(decoded_[bank][tile + part], colors, attrs.flip_x, attrs.flip_y, out, kViewerWidth);
+    }
+  }
+}
+
+void VramViewer::DrawPalettes(const VramSnapshot &snapshot) {
+  for (int entry = 0; entry < PPU::kPaletteEntries; ++entry) {
+    int x = kPaletteOrigin[0] + (entry % 4) * kSwatchSize;
+    int y = kPaletteOrigin[1] + (entry / 4) * kSwatchSize;
+    for (int row = 0; row < kSwatchSize; ++row) {
+      std::fill_n(pixels_ + (y + row) * kViewerWidth + x, kSwatchSize, snapshot.palette_rgb[entry]);
+    }
+  }
+}
+
+}  // namespace Debug
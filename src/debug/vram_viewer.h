@@ -0,0 +1,62 @@
+//
+// Created by Brian Bonafilia on 12/30/24.
+//
+
+#ifndef GB_EMU_SRC_DEBUG_VRAM_VIEWER_H_
+#define GB_EMU_SRC_DEBUG_VRAM_VIEWER_H_
+
+#include <cstdint>
+#include "../ppu.h"
+
+namespace Debug {
+
+// Layout of the viewer image:
+//   (0, 0)     BG map 0x9800          (256, 0)   BG map 0x9C00
+//   (0, 256)   tiles of bank 0        (128, 256) tiles of bank 1
+//   (256, 256) the 40 OBJs            (384, 256) the 16 palettes
+constexpr int kViewerWidth = 512;
+constexpr int kViewerHeight = 512;
+
+// What the viewer draws from, copied from the emulation at the end of a frame.
+struct VramSnapshot {
+  uint8_t vram[2][0x2000];
+  uint8_t oam[0xA0];
+  uint32_t palette_rgb[PPU::kPaletteEntries];
+  uint8_t lcdc;
+  bool cgb_mode;
+};
+
+// Emulation side: copy what the viewer needs and hand it to the render side.
+// Only a few memcpys, all decoding happens in VramViewer.
+void PublishVramSnapshot(const PPU::PpuState& state);
+
+// Render side: keeps the viewer image between frames and only redraws the
+// tiles and map cells that changed since the last snapshot it drew.
+class VramViewer {
+ public:
+  // Redraw from the newest published snapshot, false if there was none.
+  bool Update();
+
+  const uint32_t* pixels() const {
+    return pixels_;
+  }
+
+ private:
+  void DecodeChangedTiles(const VramSnapshot& snapshot, bool redraw_all);
+  void DrawTileData(const VramSnapshot& snapshot, bool redraw_all);
+  void DrawMaps(const VramSnapshot& snapshot, bool redraw_all);
+  void DrawOam(const VramSnapshot& snapshot);
+  void DrawPalettes(const VramSnapshot& snapshot);
+
+  // The snapshot drawn last, diffed against to find what changed.
+  VramSnapshot drawn_{};
+  bool has_drawn_ = false;
+  // Tiles whose decoded pixels changed in this update.
+  bool tile_changed_[2][PPU::kTilesPerBank]{};
+  uint8_t decoded_[2][PPU::kTilesPerBank][64]{};
+  uint32_t pixels_[kViewerWidth * kViewerHeight]{};
+};
+
+}  // namespace Debug
+
+#endif //GB_EMU_SRC_DEBUG_VRAM_VIEWER_H_
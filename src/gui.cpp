@@ -5,11 +5,29 @@
 #include <SDL2/SDL.h>
 #include <iostream>
 #include "cartridge.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <random>
 #include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "apu.h"
 #include "cpu.h"
+#include "gui.h"
 #include "ppu.h"
+#include "triple_buffer.h"
+#include "rendering/indexed_frame.h"
+#include "rendering/upscale.h"
+#include "audio/audio_ring.h"
+#include "audio/rate_control.h"
+#include "capture/audio_capture.h"
+#include "debug/vram_viewer.h"
 
 namespace GUI {
 
@@ -27,27 +45,163 @@ constexpr int kSreenHeight = 720;
 constexpr int kPixelWidth = 160;
 constexpr int kPixelHeight = 144;
 
-constexpr int kDScreenWidth = 360;
-constexpr int kDScreenHeight = 720;
-
-constexpr int kDPixelWidth = 256;
-constexpr int kDPixelHeight = 512;
+constexpr int kDScreenWidth = 768;
+constexpr int kDScreenHeight = 768;
 
+// Key state, owned by the main thread which handles the SDL events.
 CPU::Joypad actions{.joypad_input = 0xFF};
 CPU::Joypad direction{.joypad_input = 0xFF};
 
-// May make this more accurate i guess later, probably does not matter. Currently 60FPS.
-constexpr uint32_t kFrameTimeInMs = 14;
+// A frame is 70224 clocks of the 4 MiHz clock, 59.73 frames per second.
+constexpr uint64_t kFrameClocks = 70224;
+
+/* Shared between the main thread and the emulation thread */
+// Finished frames, published by the emulation thread at VBlank and presented
+// by the main thread.
+TripleBuffer<std::array<uint32_t, kPixelWidth * kPixelHeight>> frames;
+TripleBuffer<PPU::IndexedFrame> indexed_frames;
+// Joypad buttons as of the last key event, 0 bits are pressed.
+std::atomic<uint8_t> action_buttons{0xF};
+std::atomic<uint8_t> direction_buttons{0xF};
+std::atomic<bool> is_running{true};
+std::atomic<bool> save_requested{false};
+std::atomic<bool> debug_logging{false};
+
+// Owned by the main thread, redrawn from the snapshots the PPU publishes.
+Debug::VramViewer vram_viewer;
+
+/* Audio, queued by the emulation thread and played from the SDL callback */
+// Frames per callback, about 11 ms.
+constexpr int kAudioDeviceFrames = 512;
+// Fill the rate control holds the ring at, 40 ms.
+constexpr int kAudioTargetFrames = APU::kSampleRate * 40 / 1000;
+// A frame's samples at the largest rate adjustment, with room to spare.
+constexpr int kMaxFrameSamples = 1024;
+SDL_AudioDeviceID audio_device = 0;
+bool audio_playing = false;
+APU::AudioRing<4096> audio_ring;
+APU::RateControl rate_control(kAudioTargetFrames);
+Pacing pacing = timer_pacing;
+// Under audio_pacing the emulation thread sleeps here until the callback has
+// made room in the ring.
+std::mutex audio_mutex;
+std::condition_variable audio_consumed;
+// Wake up anyway after this long, so a stalled device cannot hang shutdown.
+constexpr std::chrono::milliseconds kAudioWaitTimeout{100};
 
-void UpdateTexture(uint32_t *pixels) {
-  SDL_UpdateTexture(game_pixels, nullptr, pixels, kPixelWidth * sizeof(uint32_t));
+/* CPU upscaling, done by the main thread and its helpers */
+constexpr int kMaxScaleThreads = 4;
+// Frames averaged for the filter cost in the window title.
+constexpr int kCostReportFrames = 60;
+bool upscale = false;
+PPU::ScaleFilter scale_filter = PPU::nearest_filter;
+std::unique_ptr<PPU::Upscaler> upscaler;
+// Indexed frames are expanded here before they are scaled.
+std::array<uint32_t, kPixelWidth * kPixelHeight> unscaled;
+double filter_us = 0;
+int filtered_frames = 0;
+
+void SetPacing(Pacing mode) {
+  pacing = mode;
+}
+
+void SetScaleFilter(PPU::ScaleFilter filter) {
+  upscale = true;
+  scale_filter = filter;
+}
+
+void PublishFrame(const uint32_t *pixels) {
+  memcpy(frames.back().data(), pixels, sizeof(uint32_t) * kPixelWidth * kPixelHeight);
+  frames.Publish();
+}
+
+void PublishIndexedFrame(const PPU::IndexedFrame &frame) {
+  PPU::CopyIndexedFrame(frame, &indexed_frames.back());
+  indexed_frames.Publish();
+}
+
+// Texels of the game texture to write a frame into, nullptr on failure.
+uint32_t *LockGamePixels(int &stride) {
+  void *texels;
+  int pitch;
+  if (SDL_LockTexture(game_pixels, nullptr, &texels, &pitch) != 0) {
+    return nullptr;
+  }
+  stride = pitch / static_cast<int>(sizeof(uint32_t));
+  return static_cast<uint32_t *>(texels);
+}
+
+// Expand an indexed frame straight into the texture.
+void UploadIndexedFrame(const PPU::IndexedFrame &frame) {
+  int stride;
+  if (uint32_t *texels = LockGamePixels(stride)) {
+    PPU::ExpandIndexedFrame(frame, texels, stride);
+    SDL_UnlockTexture(game_pixels);
+  }
+}
+
+// Shows the average cost of the filter in the window title.
+void ReportFilterCost() {
+  filter_us += upscaler->last_frame_us();
+  if (++filtered_frames < kCostReportFrames) {
+    return;
+  }
+  char title[64];
+  snprintf(title, sizeof(title), "GB EMU - %s %.2f ms/frame", PPU::FilterName(upscaler->filter()),
+           filter_us / filtered_frames / 1000);
+  SDL_SetWindowTitle(window, title);
+  filter_us = 0;
+  filtered_frames = 0;
+}
+
+void UploadScaledFrame(const uint32_t *pixels) {
+  int stride;
+  if (uint32_t *texels = LockGamePixels(stride)) {
+    upscaler->Scale(pixels, texels, stride);
+    SDL_UnlockTexture(game_pixels);
+    ReportFilterCost();
+  }
+}
+
+// Write the newest frame to the game texture, false if there was no new one.
+bool UploadFrame() {
+  const uint32_t *pixels;
+  if (indexed_frames.Consume()) {
+    if (!upscaler) {
+      UploadIndexedFrame(indexed_frames.front());
+      return true;
+    }
+    PPU::ExpandIndexedFrame(indexed_frames.front(), unscaled.data(), kPixelWidth);
+    pixels = unscaled.data();
+  } else if (frames.Consume()) {
+    pixels = frames.front().data();
+  } else {
+    return false;
+  }
+  if (upscaler) {
+    UploadScaledFrame(pixels);
+  } else {
+    SDL_UpdateTexture(game_pixels, nullptr, pixels, kPixelWidth * sizeof(uint32_t));
+  }
+  return true;
+}
+
+// Upload and present the newest frame, false if there was no new one.
+bool PresentFrame() {
+  if (!UploadFrame()) {
+    return false;
+  }
   SDL_RenderClear(renderer);
   SDL_RenderCopy(renderer, game_pixels, nullptr, nullptr);
   SDL_RenderPresent(renderer);
+  return true;
 }
 
-void DrawDebugScreen(uint32_t *pixels) {
-  SDL_UpdateTexture(debug_pixels, nullptr, pixels, kDPixelWidth * sizeof(uint32_t));
+void PresentDebugScreen() {
+  if (!vram_viewer.Update()) {
+    return;
+  }
+  SDL_UpdateTexture(debug_pixels, nullptr, vram_viewer.pixels(), Debug::kViewerWidth * sizeof(uint32_t));
   SDL_RenderClear(debug_renderer);
   SDL_RenderCopy(debug_renderer, debug_pixels, nullptr, nullptr);
   SDL_RenderPresent(debug_renderer);
@@ -58,21 +212,119 @@ void SetControllerState(CPU::Joypad &controller) {
   if ((controller.joypad_input & 0xF0) == 0x30) {
     controller.joypad_input = 0x3F;
   } else if ((controller.joypad_input & 0xF0) == 0x20) {
-    controller.buttons = direction.buttons;
+    controller.buttons = direction_buttons.load(std::memory_order_relaxed);
   } else if ((controller.joypad_input & 0xF0) == 0x10) {
-    controller.buttons = actions.buttons;
+    controller.buttons = action_buttons.load(std::memory_order_relaxed);
+  }
+}
+
+void SetButtons(uint8_t actions, uint8_t directions) {
+  action_buttons = actions & 0xF;
+  direction_buttons = directions & 0xF;
+}
+
+// Audio thread, called by SDL whenever the device wants more samples.
+void PlayAudio(void *, Uint8 *stream, int length) {
+  int16_t *out = reinterpret_cast<int16_t *>(stream);
+  int frames = length / (2 * sizeof(int16_t));
+  int played = audio_ring.Read(out, frames);
+  // on an underrun play silence rather than stale samples.
+  std::fill(out + played * 2, out + frames * 2, 0);
+  if (pacing == audio_pacing) {
+    // taking the lock orders this after a waiter's check of the fill, so
+    // the notify cannot be lost between its check and its wait.
+    { std::lock_guard<std::mutex> lock(audio_mutex); }
+    audio_consumed.notify_one();
+  }
+}
+
+void OpenAudio() {
+  SDL_AudioSpec wanted{};
+  wanted.freq = APU::kSampleRate;
+  wanted.format = AUDIO_S16SYS;
+  wanted.channels = 2;
+  wanted.samples = kAudioDeviceFrames;
+  wanted.callback = PlayAudio;
+  // the APU makes exactly this format, let SDL convert if the device differs.
+  audio_device = SDL_OpenAudioDevice(nullptr, 0, &wanted, nullptr, 0);
+  if (audio_device == 0) {
+    std::cerr << "Failed to open audio: " << SDL_GetError() << std::endl;
+  }
+}
+
+// Emulation thread, hands the samples of the last frame to the audio
+// callback. Under timer_pacing it also steers the resampling ratio by how
+// full the ring is, under audio_pacing the ratio stays nominal since the
+// device sets the pace.
+void QueueAudio() {
+  // read even without a device, which also brings a recording of the mix up
+  // to date.
+  int16_t samples[kMaxFrameSamples * 2];
+  int frames = APU::ReadSamples(samples, kMaxFrameSamples);
+  if (audio_device == 0) {
+    return;
+  }
+  Capture::SubmitAudio(Capture::device_audio, samples, frames);
+  audio_ring.Write(samples, frames);
+  if (pacing == timer_pacing) {
+    APU::SetRateAdjust(rate_control.Update(audio_ring.Frames()));
+  }
+  // start playing once there is the target latency to draw from.
+  if (!audio_playing && audio_ring.Frames() >= kAudioTargetFrames) {
+    SDL_PauseAudioDevice(audio_device, 0);
+    audio_playing = true;
   }
 }
 
-void Save() {
-  Cartridge::Save();
+// Emulation thread, blocks while the ring holds the target latency or more,
+// so frames run exactly as fast as the device plays them. One wakeup per
+// callback instead of a timer per frame.
+void WaitForAudio() {
+  std::unique_lock<std::mutex> lock(audio_mutex);
+  while (is_running && audio_playing && audio_ring.Frames() >= kAudioTargetFrames) {
+    audio_consumed.wait_for(lock, kAudioWaitTimeout);
+  }
+}
+
+// Emulation thread, runs and paces frames until the window is closed. Under
+// timer_pacing frames are due at fixed points in time, so the delays never
+// add up to drift.
+void RunEmulation() {
+  const uint64_t frequency = SDL_GetPerformanceFrequency();
+  const uint64_t frame_ticks = frequency * kFrameClocks / APU::kClockRate;
+  uint64_t deadline = SDL_GetPerformanceCounter();
+  while (is_running) {
+    if (save_requested.exchange(false)) {
+      Cartridge::Save();
+    }
+    CPU::RunFrame(debug_logging);
+    if (pacing == audio_pacing) {
+      WaitForAudio();
+      QueueAudio();
+      continue;
+    }
+    QueueAudio();
+    deadline += frame_ticks;
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (now < deadline) {
+      SDL_Delay((deadline - now) * 1000 / frequency);
+    } else if (now - deadline > frame_ticks) {
+      // more than a frame behind, start over from now instead of rushing.
+      deadline = now;
+    }
+  }
 }
 
 void Init(bool debug) {
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS) < 0) {
     std::cerr << "Failed to initialize video" << std::endl;
     exit(1);
   }
+  OpenAudio();
+  if (audio_device == 0 && pacing == audio_pacing) {
+    std::cerr << "No audio device to pace by, pacing by the timer" << std::endl;
+    pacing = timer_pacing;
+  }
 
   window = SDL_CreateWindow("GB EMU",
                             SDL_WINDOWPOS_CENTERED,
@@ -91,8 +343,15 @@ void Init(bool debug) {
   }
 
   SDL_RenderSetLogicalSize(renderer, kPixelWidth, kPixelHeight);
-  game_pixels =
-      SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, kPixelWidth, kPixelHeight);
+  int scale = 1;
+  if (upscale) {
+    // leave a core to the emulation thread.
+    int threads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1, kMaxScaleThreads);
+    upscaler = std::make_unique<PPU::Upscaler>(scale_filter, threads);
+    scale = PPU::ScaleFactor(scale_filter);
+  }
+  game_pixels = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING,
+                                  kPixelWidth * scale, kPixelHeight * scale);
 
   if (debug) {
     debug_window = SDL_CreateWindow("Debug Info",
@@ -106,16 +365,16 @@ void Init(bool debug) {
     debug_pixels = SDL_CreateTexture(debug_renderer,
                                      SDL_PIXELFORMAT_RGB888,
                                      SDL_TEXTUREACCESS_STREAMING,
-                                     kDPixelWidth,
-                                     kDPixelHeight);
+                                     Debug::kViewerWidth,
+                                     Debug::kViewerHeight);
     PPU::set_debug(debug);
   }
 
-  bool is_running = true;
+  debug_logging = debug;
+  std::thread emulation(RunEmulation);
 
   while (is_running) {
     SDL_Event e;
-    uint32_t startTime = SDL_GetTicks();
     while (SDL_PollEvent(&e)) {
       if (e.type == SDL_QUIT || (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE)) {
         is_running = false;
@@ -125,7 +384,7 @@ void Init(bool debug) {
             direction.select_or_up = false;
             break;
           case SDLK_s:
-            Save();
+            save_requested = true;
             break;
           case SDLK_DOWN:
             direction.start_or_down = false;
@@ -149,7 +408,7 @@ void Init(bool debug) {
             actions.select_or_up = false;
             break;
           case SDLK_p:
-            debug = ~debug;
+            debug_logging = !debug_logging;
         }
       } else if (e.type == SDL_KEYUP) {
         switch (e.key.keysym.sym) {
@@ -180,15 +439,23 @@ void Init(bool debug) {
         }
       }
     }
-    CPU::RunFrame(debug);
-    uint32_t latency = SDL_GetTicks() - startTime;
-    if (latency < kFrameTimeInMs) {
-      SDL_Delay(kFrameTimeInMs - latency);
-    } else {
-      printf("not hitting desired frame rate\n");
+    action_buttons = actions.buttons;
+    direction_buttons = direction.buttons;
+    // present blocks on VSYNC, which only holds up this thread.
+    bool presented = PresentFrame();
+    if (debug) {
+      PresentDebugScreen();
+    }
+    if (!presented) {
+      SDL_Delay(1);
     }
   }
+  emulation.join();
 
+  if (audio_device != 0) {
+    SDL_CloseAudioDevice(audio_device);
+  }
+  upscaler.reset();
   SDL_DestroyTexture(game_pixels);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
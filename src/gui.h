@@ -7,17 +7,47 @@
 
 #include <cstdint>
 #include "cpu.h"
+#include "rendering/upscale.h"
+
+namespace PPU {
+struct IndexedFrame;
+}
 
 namespace GUI {
 
+// Upscale frames on the CPU with filter before they are uploaded, instead of
+// leaving all of the stretching to the renderer. Call before Init.
+void SetScaleFilter(PPU::ScaleFilter filter);
+
+// What sets the speed of emulation.
+enum Pacing {
+  // Frames are due every 1/59.73 s by the performance counter, and the audio
+  // is resampled by a fraction of a percent to keep up with the device.
+  timer_pacing,
+  // Frames run as fast as the audio device consumes their samples, blocking
+  // while the ring is full. Drift free, but the frame rate follows the
+  // device's clock. Falls back to timer_pacing without an audio device.
+  audio_pacing
+};
+
+// Call before Init.
+void SetPacing(Pacing mode);
+
 void Init(bool debug);
 
-void UpdateTexture(uint32_t* pixels);
+// Hand a finished frame to the main thread for presenting. Called by the
+// emulation thread, never blocks.
+void PublishFrame(const uint32_t* pixels);
 
-void DrawDebugScreen(uint32_t* pixels);
+// Same for a frame in indexed_pixels format, expanded to RGB when presented.
+void PublishIndexedFrame(const PPU::IndexedFrame& frame);
 
 void SetControllerState(CPU::Joypad& controller);
 
+// Hold buttons without a window, for headless runs. Bits as in the joypad
+// register, 0 is pressed.
+void SetButtons(uint8_t actions, uint8_t directions);
+
 }  // namespace
 
 #endif //GB_EMU_SRC_GUI_H_
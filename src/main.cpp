@@ -1,24 +1,108 @@
 //
 // Created by Brian Bonafilia on 9/7/24.
 //
+#include <cstring>
 #include <iostream>
+#include <string>
+#include "capture/audio_capture.h"
+#include "capture/frame_capture.h"
 #include "cpu.h"
 #include "gui.h"
 #include "cartridge.h"
+#include "memory_arena.h"
+#include "ppu.h"
 
 constexpr char kDebugFlag[] = "--debug";
+constexpr char kMemReportFlag[] = "--mem-report";
+constexpr char kScanlineFlag[] = "--scanline";
+constexpr char kLcdColorsFlag[] = "--lcd-colors";
+constexpr char kPipelinedFlag[] = "--pipelined";
+constexpr char kSpansFlag[] = "--spans";
+constexpr char kIndexedFlag[] = "--indexed";
+constexpr char kNearestFlag[] = "--nearest";
+constexpr char kScale2xFlag[] = "--scale2x";
+constexpr char kScale3xFlag[] = "--scale3x";
+constexpr char kXbrFlag[] = "--xbr";
+// Pace emulation by the audio device instead of the timer.
+constexpr char kAudioSyncFlag[] = "--audio-sync";
+// --capture=<file>, Y4M when the file ends in .y4m and raw RGB otherwise.
+constexpr char kCaptureFlag[] = "--capture=";
+constexpr char kCaptureLosslessFlag[] = "--capture-lossless";
+// --audio-capture=<file>, a WAV of the APU mix, or with --audio-capture-device
+// of the samples as played after rate control.
+constexpr char kAudioCaptureFlag[] = "--audio-capture=";
+constexpr char kAudioCaptureDeviceFlag[] = "--audio-capture-device";
 
 int main(int argc, char* argv[]) {
   bool debug = false;
+  std::string capture_path;
+  std::string audio_capture_path;
+  Capture::AudioTap audio_tap = Capture::mixer_audio;
+  Capture::OverflowPolicy capture_policy = Capture::drop_frames;
   for (int i = 0; i < argc; i++) {
     if (std::string(argv[i]) == kDebugFlag) {
       debug = true;
+    } else if (std::string(argv[i]) == kMemReportFlag) {
+      Memory::PrintFootprint();
+    } else if (std::string(argv[i]) == kScanlineFlag) {
+      PPU::set_render_mode(PPU::scanline_renderer);
+    } else if (std::string(argv[i]) == kPipelinedFlag) {
+      PPU::set_render_mode(PPU::pipelined_renderer);
+    } else if (std::string(argv[i]) == kSpansFlag) {
+      PPU::set_render_mode(PPU::span_renderer);
+    } else if (std::string(argv[i]) == kLcdColorsFlag) {
+      PPU::set_color_profile(PPU::lcd_colors);
+    } else if (std::string(argv[i]) == kIndexedFlag) {
+      PPU::set_frame_format(PPU::indexed_pixels);
+    } else if (std::string(argv[i]) == kNearestFlag) {
+      GUI::SetScaleFilter(PPU::nearest_filter);
+    } else if (std::string(argv[i]) == kScale2xFlag) {
+      GUI::SetScaleFilter(PPU::scale2x_filter);
+    } else if (std::string(argv[i]) == kScale3xFlag) {
+      GUI::SetScaleFilter(PPU::scale3x_filter);
+    } else if (std::string(argv[i]) == kXbrFlag) {
+      GUI::SetScaleFilter(PPU::xbr_lite_filter);
+    } else if (std::string(argv[i]) == kAudioSyncFlag) {
+      GUI::SetPacing(GUI::audio_pacing);
+    } else if (std::string(argv[i]).rfind(kCaptureFlag, 0) == 0) {
+      capture_path = argv[i] + strlen(kCaptureFlag);
+    } else if (std::string(argv[i]) == kCaptureLosslessFlag) {
+      capture_policy = Capture::block_until_written;
+    } else if (std::string(argv[i]).rfind(kAudioCaptureFlag, 0) == 0) {
+      audio_capture_path = argv[i] + strlen(kAudioCaptureFlag);
+    } else if (std::string(argv[i]) == kAudioCaptureDeviceFlag) {
+      audio_tap = Capture::device_audio;
     }
   }
-  if (argc < 1) {
+  if (argc < 2) {
     std::cerr << "must include a rom to play :) " << std::endl;
+    return 1;
+  }
+  if (!Cartridge::load_cartridge(argv[argc - 1])) {
+    return 1;
   }
-  Cartridge::load_cartridge(argv[argc - 1]);
   CPU::InitializeRegisters(Cartridge::IsCgbMode());
+  if (!capture_path.empty()) {
+    bool y4m = capture_path.size() > 4 && capture_path.compare(capture_path.size() - 4, 4, ".y4m") == 0;
+    Capture::Start(capture_path.c_str(), y4m ? Capture::y4m_video : Capture::raw_rgb_video, capture_policy,
+                   CPU::Clock());
+  }
+  // started at the clock the video counts its frame periods from, so both
+  // files start at the same emulated moment.
+  if (!audio_capture_path.empty()) {
+    Capture::StartAudio(audio_capture_path.c_str(), audio_tap, capture_policy);
+  }
   GUI::Init(debug);
+  if (Capture::IsCapturing()) {
+    Capture::Stop(CPU::Clock());
+    if (Capture::DroppedFrames() > 0) {
+      std::cerr << "capture dropped " << Capture::DroppedFrames() << " frames" << std::endl;
+    }
+  }
+  if (Capture::IsCapturingAudio(audio_tap)) {
+    Capture::StopAudio();
+    if (Capture::DroppedAudioFrames() > 0) {
+      std::cerr << "audio capture dropped " << Capture::DroppedAudioFrames() << " frames" << std::endl;
+    }
+  }
 }
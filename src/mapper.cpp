@@ -3,25 +3,22 @@
 //
 
 #include "mapper.h"
+#include "memory_arena.h"
 
 Mapper::Mapper(uint8_t *rom) {
   rom_ = rom;
-  ram_ = new uint8_t[0x2000];
+  ram_ = Memory::arena.cart_ram;
 }
 
 Mapper::Mapper(uint8_t *rom, uint8_t* ram) {
   rom_ = rom;
   if (ram == nullptr) {
-    ram_ = new uint8_t[0x2000];
+    ram_ = Memory::arena.cart_ram;
   } else {
     ram_ = ram;
   }
 }
 
-Mapper::~Mapper() {
-  delete [] ram_;
-}
-
 uint8_t Mapper::read(uint16_t addr) {
   if (addr >= 0xA000) {
     return ram_[addr - 0xA000];
@@ -48,3 +45,10 @@ uint8_t* Mapper::get_ram() {
   return ram_;
 }
 
+const uint8_t* Mapper::get_host_ptr(uint16_t addr) {
+  if (addr >= 0xA000) {
+    return ram_ + (addr - 0xA000);
+  }
+  return rom_ + addr;
+}
+
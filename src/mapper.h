@@ -7,15 +7,20 @@
 
 #include <cstdint>
 
+// Cartridge without a memory bank controller, also the base of the MBCs.
+// Mappers are not polymorphic, the cartridge holds the concrete type in a
+// std::variant so calls can be inlined.
 class Mapper {
  public:
   explicit Mapper(uint8_t* rom);
-  ~Mapper();
   // Pass in the addr assume starts at 0
-  virtual uint8_t read(uint16_t addr);
-  virtual uint8_t write(uint16_t addr, uint8_t val);
-  virtual uint8_t get_bank(uint16_t addr);
-  virtual uint8_t* get_ram();
+  uint8_t read(uint16_t addr);
+  uint8_t write(uint16_t addr, uint8_t val);
+  uint8_t get_bank(uint16_t addr);
+  uint8_t* get_ram();
+  // Host memory backing addr for reads, or nullptr if it is not plain memory.
+  // The pointer stays valid up to the end of the 0x1000 byte page of addr.
+  const uint8_t* get_host_ptr(uint16_t addr);
 
  protected:
   Mapper(uint8_t* rom, uint8_t* ram);
@@ -24,7 +24,7 @@ uint8_t MBC1::read(uint16_t addr) {
         return 0xFF;
       }
       if (advanced_banking) {
-        int low_offset = 0x4000 * (rom_low_bank_index & 0x3);
+        int low_offset = 0x2000 * (rom_low_bank_index & 0x3);
         return ram_[(int) addr - 0xA000 + low_offset];
       }
       return ram_[(int) addr - 0xA000];
@@ -61,6 +61,28 @@ uint8_t MBC1::write(uint16_t addr, uint8_t val) {
   return val;
 }
 
+const uint8_t* MBC1::get_host_ptr(uint16_t addr) {
+  switch (addr) {
+    case 0x0000 ... 0x3FFF:
+      if (advanced_banking) {
+        return rom_ + addr + 0x4000 * rom_low_bank_index;
+      }
+      return rom_ + addr;
+    case 0x4000 ... 0x7FFF:
+      return rom_ + addr + 0x4000 * (rom_bank_index_ - 1);
+    case 0xA000 ... 0xBFFF:
+      if (!ram_enabled_) {
+        return nullptr;
+      }
+      if (advanced_banking) {
+        return ram_ + (addr - 0xA000) + 0x2000 * (rom_low_bank_index & 0x3);
+      }
+      return ram_ + (addr - 0xA000);
+    default:
+      return nullptr;
+  }
+}
+
 uint8_t MBC1::get_bank(uint16_t addr) {
   switch (addr) {
     case 0x0000 ... 0x3FFF:
@@ -61,6 +61,22 @@ uint8_t MBC3::write(uint16_t addr, uint8_t val) {
   return val;
 }
 
+const uint8_t* MBC3::get_host_ptr(uint16_t addr) {
+  switch (addr) {
+    case 0x0000 ... 0x3FFF:
+      return rom_ + addr;
+    case 0x4000 ... 0x7FFF:
+      return rom_ + addr + 0x4000 * (rom_bank_index_ - 1);
+    case 0xA000 ... 0xBFFF:
+      if (!ram_enabled_) {
+        return nullptr;
+      }
+      return ram_ + (addr - 0xA000) + 0x2000 * (rom_low_bank_index & 0x3);
+    default:
+      return nullptr;
+  }
+}
+
 uint8_t MBC3::get_bank(uint16_t addr) {
   switch (addr) {
     case 0x0000 ... 0x3FFF:
@@ -10,9 +10,10 @@ class MBC3 : public Mapper {
  public:
   explicit MBC3(uint8_t* rom, uint8_t* ram, int rom_size, int ram_size);
 
-  uint8_t read(uint16_t addr) override;
-  uint8_t write(uint16_t addr, uint8_t val) override;
-  uint8_t get_bank(uint16_t addr) override;
+  uint8_t read(uint16_t addr);
+  uint8_t write(uint16_t addr, uint8_t val);
+  uint8_t get_bank(uint16_t addr);
+  const uint8_t* get_host_ptr(uint16_t addr);
 
  private:
   bool advanced_banking = false;
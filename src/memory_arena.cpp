@@ -0,0 +1,39 @@
+//
+// Created by Brian Bonafilia on 12/16/24.
+//
+
+#include "memory_arena.h"
+
+#include <cstdio>
+
+namespace Memory {
+
+Arena arena{};
+
+namespace {
+
+void PrintRegion(const char* name, size_t offset, size_t size) {
+  printf("  %-12s offset 0x%05zX size 0x%05zX (cache lines %zu-%zu)\n", name, offset, size,
+         offset / kCacheLineSize, (offset + size - 1) / kCacheLineSize);
+}
+
+}  // namespace
+
+void PrintFootprint() {
+  printf("guest memory arena: %zu bytes per instance (%zu cache lines)\n",
+         sizeof(Arena), sizeof(Arena) / kCacheLineSize);
+  PrintRegion("hram", offsetof(Arena, hram), sizeof(Arena::hram));
+  PrintRegion("oam", offsetof(Arena, oam), sizeof(Arena::oam));
+  PrintRegion("oam_buffer", offsetof(Arena, oam_buffer), sizeof(Arena::oam_buffer));
+  PrintRegion("serial_port", offsetof(Arena, serial_port), sizeof(Arena::serial_port));
+  PrintRegion("bg_cram", offsetof(Arena, bg_cram), sizeof(Arena::bg_cram));
+  PrintRegion("obj_cram", offsetof(Arena, obj_cram), sizeof(Arena::obj_cram));
+  PrintRegion("wave_ram", offsetof(Arena, wave_ram), sizeof(Arena::wave_ram));
+  PrintRegion("wram", offsetof(Arena, wram), sizeof(Arena::wram));
+  PrintRegion("vram", offsetof(Arena, vram), sizeof(Arena::vram));
+  PrintRegion("vram_bank1", offsetof(Arena, vram_bank1), sizeof(Arena::vram_bank1));
+  PrintRegion("cart_ram", offsetof(Arena, cart_ram), sizeof(Arena::cart_ram));
+  PrintRegion("pixels", offsetof(Arena, pixels), sizeof(Arena::pixels));
+}
+
+}  // namespace Memory
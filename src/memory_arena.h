@@ -0,0 +1,58 @@
+//
+// Created by Brian Bonafilia on 12/16/24.
+//
+
+#ifndef GB_EMU_SRC_MEMORY_ARENA_H_
+#define GB_EMU_SRC_MEMORY_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Memory {
+
+constexpr size_t kCacheLineSize = 64;
+
+constexpr int kScreenWidth = 160;
+constexpr int kScreenHeight = 144;
+
+// All guest memory in one fixed, cache line aligned layout. Small regions
+// touched on almost every instruction or dot are packed together at the
+// front so they share cache lines, the large banked regions follow.
+struct alignas(kCacheLineSize) Arena {
+  /* Hot regions */
+  // 0xFF80-0xFFFE, the last byte is unused.
+  uint8_t hram[0x80];
+  // 0xFE00-0xFE9F
+  uint8_t oam[0xA0];
+  // OBJs found on the current line during OAM scan.
+  uint8_t oam_buffer[0x28];
+  // 0xFF01-0xFF02
+  uint8_t serial_port[0x2];
+  // CGB palette memory, accessed through 0xFF69 and 0xFF6B.
+  uint8_t bg_cram[0x40];
+  uint8_t obj_cram[0x40];
+  // 0xFF30-0xFF3F, 32 4 bit samples played by the wave channel.
+  uint8_t wave_ram[0x10];
+
+  /* Banked regions */
+  // 0xC000-0xDFFF, 8 banks of 4KiB in CGB mode.
+  alignas(kCacheLineSize) uint8_t wram[0x8000];
+  // 0x8000-0x9FFF
+  alignas(kCacheLineSize) uint8_t vram[0x2000];
+  alignas(kCacheLineSize) uint8_t vram_bank1[0x2000];
+  // 0xA000-0xBFFF, up to 4 banks of 8KiB.
+  alignas(kCacheLineSize) uint8_t cart_ram[0x8000];
+
+  /* Output */
+  alignas(kCacheLineSize) uint32_t pixels[kScreenWidth * kScreenHeight];
+};
+
+// Guest memory of the running emulator.
+extern Arena arena;
+
+// Print the size and offset of every region of an arena instance.
+void PrintFootprint();
+
+}  // namespace Memory
+
+#endif //GB_EMU_SRC_MEMORY_ARENA_H_
@@ -2,25 +2,59 @@
 // Created by Brian Bonafilia on 10/18/24.
 //
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include "ppu.h"
 #include "cpu.h"
 #include "gui.h"
+#include "memory_arena.h"
+#include "debug/vram_viewer.h"
+#include "ppu_worker.h"
 #include "rendering/draw.h"
+#include "rendering/indexed_frame.h"
+#include "rendering/palette.h"
 
 namespace PPU {
 namespace {
-uint8_t *vram = new uint8_t[0x2000];
-uint8_t *vram_bank1 = new uint8_t[0x2000];
-uint8_t *oam_buffer = new uint8_t[0x28];
-uint8_t *oam = new uint8_t[0xA0];
-uint32_t *pixels = new uint32_t[144 * 156];
+uint8_t *const vram = Memory::arena.vram;
+uint8_t *const vram_bank1 = Memory::arena.vram_bank1;
+uint8_t *const oam_buffer = Memory::arena.oam_buffer;
+uint8_t *const oam = Memory::arena.oam;
+uint32_t *const pixels = Memory::arena.pixels;
+// VRAM bank selected by 0xFF4F, only updated when that register is written.
+uint8_t *active_vram = vram;
+
+// Mode 3 without any penalty.
+constexpr int kMinDrawDots = 172;
 
-int current_dot = 0;
 Registers registers{.LCDC = 0x91};
 bool debug = false;
+RenderMode render_mode = dot_renderer;
+ColorProfile color_profile = raw_colors;
+ObjLine obj_line{};
+// Zeroed VRAM decodes to zeroes, so the cache starts out valid.
+TileCache tile_cache{};
+IndexedFrame indexed{};
+
+// A register write made during mode 3, replayed by the span renderer.
+struct LineWrite {
+  uint16_t dot;
+  uint16_t addr;
+  uint8_t val;
+};
+// Mode 3 is under 300 dots and the CPU writes at most once per M-cycle, even
+// in double speed mode this does not fill up.
+constexpr int kMaxLineWrites = 160;
+LineWrite line_writes[kMaxLineWrites];
+int line_write_count = 0;
+// Registers as they were when mode 3 of the current line started, with
+// palette memory copied aside so writes during the line can be replayed.
+Registers line_start_registers;
+uint8_t line_bg_cram[0x40];
+uint8_t line_obj_cram[0x40];
 
 PpuState state{
     .registers = registers,
@@ -29,8 +63,168 @@ PpuState state{
     .oam = oam,
     .oam_buffer = oam_buffer,
     .pixels = pixels,
+    .indexed = nullptr,
+    .obj_line = &obj_line,
+    .tile_cache = &tile_cache,
 };
 
+int ActiveVramBank() {
+  return active_vram == vram_bank1 ? 1 : 0;
+}
+
+// Hand a write that changes what is drawn to the pipelined renderer.
+void LogDrawingWrite(uint16_t addr, uint8_t val) {
+  if (render_mode == pipelined_renderer) {
+    LogWrite(registers.LY, registers.current_dot, addr, val);
+  }
+}
+
+// Same for a DMA copy of length bytes to VRAM or OAM.
+void LogDrawingBlock(uint16_t addr, const uint8_t *data, int length) {
+  if (render_mode == pipelined_renderer) {
+    LogBlock(registers.LY, registers.current_dot, addr, data, length);
+  }
+}
+
+// Registers the pipelined renderer replays, the rest only affect timing.
+bool IsDrawingRegister(uint16_t addr) {
+  switch (addr) {
+    case 0xFF40:
+    case 0xFF42:
+    case 0xFF43:
+    case 0xFF47:
+    case 0xFF48:
+    case 0xFF49:
+    case 0xFF4A:
+    case 0xFF4B:
+    case 0xFF4F:
+    case 0xFF68:
+    case 0xFF69:
+    case 0xFF6A:
+    case 0xFF6B:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Registers whose writes the span renderer queues. Palette memory is in as
+// well, the CPU can reach it during mode 3 here.
+bool IsLineRegister(uint16_t addr) {
+  switch (addr) {
+    case 0xFF40:
+    case 0xFF42:
+    case 0xFF43:
+    case 0xFF47:
+    case 0xFF48:
+    case 0xFF49:
+    case 0xFF4A:
+    case 0xFF4B:
+    case 0xFF68:
+    case 0xFF69:
+    case 0xFF6A:
+    case 0xFF6B:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void QueueLineWrite(uint16_t addr, uint8_t val) {
+  if (render_mode == span_renderer && registers.mode == draw && line_write_count < kMaxLineWrites) {
+    line_writes[line_write_count++] = {.dot = static_cast<uint16_t>(registers.current_dot), .addr = addr, .val = val};
+  }
+}
+
+// Mirrors access_registers for the registers in IsLineRegister. Turning the
+// LCD off never reaches here, it ends the line before it is drawn.
+void ApplyLineWrite(Registers &line_registers, const LineWrite &write) {
+  switch (write.addr) {
+    case 0xFF40:
+      line_registers.LCDC = write.val;
+      break;
+    case 0xFF42:
+      line_registers.SCY = write.val;
+      break;
+    case 0xFF43:
+      line_registers.SCX = write.val;
+      break;
+    case 0xFF47:
+      line_registers.BGP = write.val;
+      UpdateDmgPalette(line_registers, color_profile, 0);
+      break;
+    case 0xFF48:
+      line_registers.OBP0 = write.val;
+      UpdateDmgPalette(line_registers, color_profile, kObjPaletteEntries);
+      break;
+    case 0xFF49:
+      line_registers.OBP1 = write.val;
+      UpdateDmgPalette(line_registers, color_profile, kObjPaletteEntries + 4);
+      break;
+    case 0xFF4A:
+      line_registers.WY = write.val;
+      break;
+    case 0xFF4B:
+      line_registers.WX = write.val;
+      break;
+    case 0xFF68:
+      line_registers.bcps = write.val;
+      break;
+    case 0xFF69:
+      line_registers.bg_cram[line_registers.bg_color_addr] = write.val;
+      UpdateCgbPaletteColor(line_registers, color_profile, 0, line_registers.bg_color_addr);
+      if (line_registers.bg_auto_increment_color_addr) {
+        line_registers.bg_color_addr++;
+      }
+      break;
+    case 0xFF6A:
+      line_registers.ocps = write.val;
+      break;
+    case 0xFF6B:
+      line_registers.obj_cram[line_registers.obj_color_addr] = write.val;
+      UpdateCgbPaletteColor(line_registers, color_profile, kObjPaletteEntries, line_registers.obj_color_addr);
+      if (line_registers.obj_auto_increment_color_addr) {
+        line_registers.obj_color_addr++;
+      }
+      break;
+  }
+}
+
+// Draw the line mode 3 just finished from the registers it started with, one
+// span of pixels up to each queued write. A write stamped with a dot is seen
+// by the pixels drawn after that dot, as in the dot renderer.
+void DrawQueuedLine() {
+  Registers line_registers = line_start_registers;
+  PpuState line_state{
+      .registers = line_registers,
+      .vram = vram,
+      .vram_bank1 = vram_bank1,
+      .oam = oam,
+      .oam_buffer = oam_buffer,
+      .pixels = pixels,
+      .indexed = state.indexed,
+      .obj_line = &obj_line,
+      .tile_cache = &tile_cache,
+  };
+  for (int i = 0; i < line_write_count; ++i) {
+    DrawSpan(line_state, line_writes[i].dot - kOamScanDots + 1);
+    ApplyLineWrite(line_registers, line_writes[i]);
+  }
+  DrawSpan(line_state, Memory::kScreenWidth);
+  // the window state carries over to the following lines.
+  registers.is_in_window = line_registers.is_in_window;
+  registers.wx_eq = line_registers.wx_eq;
+  registers.bg_step = line_registers.bg_step;
+}
+
+// The worker renders from a copy, changes that do not go through the
+// registers need a new one.
+void ResyncWorker() {
+  if (render_mode == pipelined_renderer) {
+    StartWorker(state, ActiveVramBank(), color_profile);
+  }
+}
+
 void SetVblankInterrupt() {
   if (!registers.ppu_enable) return;
   uint8_t IF = CPU::access<CPU::read>(0xFF0F);
@@ -45,55 +239,77 @@ void SetStatInterrupt() {
   CPU::access<CPU::write>(0xFF0F, IF);
 }
 
+// A 0x10 byte block of VRAM DMA takes the same time in both speeds, which is
+// twice as many M-cycles in double speed mode.
+int VramDmaBlockCycles() {
+  return CPU::GetRegisters().double_speed_mode ? 16 : 8;
+}
+
+// Copy length bytes from the CPU address space into the selected VRAM bank.
+// The source is resolved to host memory a page at a time so every run that
+// does not cross a page boundary is a single memcpy.
+void CopyToVram(uint16_t source, uint16_t dest, int length) {
+  MarkTilesDirty(tile_cache, ActiveVramBank(), dest, std::min(length, 0x2000 - dest));
+  MarkTilesDirty(tile_cache, ActiveVramBank(), 0, dest + length - 0x2000);
+  while (length > 0) {
+    int chunk = std::min({length, 0x1000 - (source & 0xFFF), 0x2000 - dest});
+    if (const uint8_t *host = CPU::ResolveReadPage(source)) {
+      memcpy(active_vram + dest, host, chunk);
+    } else {
+      for (int i = 0; i < chunk; ++i) {
+        active_vram[dest + i] = CPU::access<CPU::read>(source + i);
+      }
+    }
+    LogDrawingBlock(0x8000 + dest, active_vram + dest, chunk);
+    source += chunk;
+    dest = (dest + chunk) & 0x1FFF;
+    length -= chunk;
+  }
+}
+
+// HBlank DMA, transfers one 0x10 byte block per HBlank.
 void HdmaTransfer() {
   if (CPU::Halted()) {
     return;
   }
-  registers.vram_dma_dest &= 0x1FFF;
-  assert(registers.vram_dma_dest <= 0x1FF0);
-  assert(registers.vram_dma_source < 0x7FF0
-             || (registers.vram_dma_source >= 0xA000 && registers.vram_dma_source <= 0xDFF0));
-  registers.dma_length--;
-  for (int i = 0; i < 0x10; ++i) {
-    int vram_idx = registers.vram_dma_dest + i;
-    int source_idx = registers.vram_dma_source + i;
-    if (registers.attr_bank) {
-      vram_bank1[vram_idx] = CPU::access<CPU::read>(source_idx);
-    } else {
-      vram[vram_idx] = CPU::access<CPU::read>(source_idx);
-    }
-  }
-  registers.vram_dma_dest += 0x10;
+  CopyToVram(registers.vram_dma_source, registers.vram_dma_dest, 0x10);
+  registers.vram_dma_dest = (registers.vram_dma_dest + 0x10) & 0x1FF0;
   registers.vram_dma_source += 0x10;
+  CPU::Stall(VramDmaBlockCycles());
   if (registers.dma_length == 0) {
+    registers.hdma_started = false;
     registers.dma_status = 0;
+  } else {
+    registers.dma_length--;
   }
 }
 
+// General purpose DMA, transfers everything at once with the CPU stalled.
 void VramDmaTransfer(int length) {
-  registers.vram_dma_dest &= 0x1FFF;
-  printf("dest %X, source %X for length %X bank is %X dma status is %X\n",
-         registers.vram_dma_dest, registers.vram_dma_source, length, registers.attr_bank, registers.dma_status);
-  assert(registers.vram_dma_dest <= 0x9FF0);
-  assert(registers.vram_dma_source < 0x7FF0
-             || (registers.vram_dma_source >= 0xA000 && registers.vram_dma_source <= 0xDFF0));
-  for (int i = 0; i < length; i++) {
-    assert(registers.vram_dma_dest + i < 0xA000);
-    int vram_idx = registers.vram_dma_dest + i;
-    int source_idx = registers.vram_dma_source + i;
-    if (registers.attr_bank) {
-      vram_bank1[vram_idx] = CPU::access<CPU::read>(source_idx);
-    } else {
-      vram[vram_idx] = CPU::access<CPU::read>(source_idx);
-    }
-  }
+  CopyToVram(registers.vram_dma_source, registers.vram_dma_dest, length);
+  registers.vram_dma_dest = (registers.vram_dma_dest + length) & 0x1FF0;
+  registers.vram_dma_source += length;
+  CPU::Stall(length / 0x10 * VramDmaBlockCycles());
   registers.dma_status = 0;
 }
 
+// OAM DMA, the 0xA0 bytes never cross a page so they are copied in one go.
+// The CPU keeps the bus busy for the length of the transfer.
 void DmaTransfer(uint8_t idx) {
-  for (int i = 0; i < 0xA0; ++i) {
-    oam[i] = CPU::access<CPU::read>((idx << 8) | i);
+  uint16_t source = idx << 8;
+  if (source >= 0xE000) {
+    // echo RAM
+    source -= 0x2000;
   }
+  if (const uint8_t *host = CPU::ResolveReadPage(source)) {
+    memcpy(oam, host, 0xA0);
+  } else {
+    for (int i = 0; i < 0xA0; ++i) {
+      oam[i] = CPU::access<CPU::read>(source + i);
+    }
+  }
+  LogDrawingBlock(kOamOffset, oam, 0xA0);
+  CPU::StartOamDma(source);
 }
 
 uint32_t ExtendBits(uint32_t bits) {
@@ -109,11 +325,24 @@ void ResetFrameState() {
   registers.wx_eq = false;
 }
 
+// Update the STAT interrupt line, requesting the interrupt on a rising edge.
+// A source that turns on while another one holds the line up is not seen.
+void UpdateStatLine() {
+  bool stat_line = (registers.lyc_stat && registers.ly_eq)
+      || (registers.mode0_stat && registers.mode == hblank)
+      || (registers.mode1_stat && registers.mode == vblank)
+      || (registers.mode2_stat && registers.mode == oam_scan);
+  if (stat_line && !registers.stat_line) {
+    SetStatInterrupt();
+  }
+  registers.stat_line = stat_line;
+}
+
 // Update the location of the current dot and line.
 void IncrementPosition() {
-  ++current_dot;
-  if (current_dot == 456) {
-    current_dot = 0;
+  ++registers.current_dot;
+  if (registers.current_dot == kDotsPerLine) {
+    registers.current_dot = 0;
     registers.x_pos = 0;
     if (registers.is_in_window) {
       registers.WLY++;
@@ -121,87 +350,212 @@ void IncrementPosition() {
     registers.is_in_window = false;
     ++registers.LY;
     if (registers.LY == 154) {
-      DrawDebugScreen(state);
+      if (debug) {
+        Debug::PublishVramSnapshot(state);
+      }
       ResetFrameState();
     }
-    if (registers.LY == registers.LYC) {
-      if (registers.lyc_stat) {
-        SetStatInterrupt();
-      }
-      registers.ly_eq = true;
-    } else {
-      registers.ly_eq = false;
+    registers.ly_eq = registers.LY == registers.LYC;
+    UpdateStatLine();
+    if (render_mode == pipelined_renderer) {
+      // keeps the worker drawing through lines without any writes.
+      LogAdvance(registers.LY, 0);
     }
   }
 }
 
-}  // namespace
+// Dots the fetcher stalls for the OBJs in the OAM buffer. Every OBJ costs 6
+// dots, plus the part of the BG tile it lands on that was not fetched yet the
+// first time an OBJ lands on that tile.
+int ObjPenaltyDots() {
+  int penalty = 0;
+  // tiles of the line, shifted by one for OBJs hanging off the left edge.
+  bool tile_seen[22]{};
+  for (int i = 0; i < 0x28 && oam_buffer[i] != 0; i += 4) {
+    int x = oam_buffer[i + 1];
+    if (x >= 168) {
+      continue;
+    }
+    if (x == 0) {
+      penalty += 11;
+      continue;
+    }
+    int fetch_x = x + registers.SCX % 8;
+    if (!tile_seen[fetch_x / 8]) {
+      tile_seen[fetch_x / 8] = true;
+      penalty += std::max(0, 5 - fetch_x % 8);
+    }
+    penalty += 6;
+  }
+  return penalty;
+}
 
-void set_debug(bool setting) {
-  debug = setting;
+// Length of mode 3 on the current line: discarding the SCX fine scroll,
+// restarting the fetcher for the window and fetching OBJs all delay it.
+int DrawDots() {
+  int dots = kMinDrawDots + registers.SCX % 8;
+  if (registers.window_enable && registers.wy_eq && registers.LY >= registers.WY && registers.WX < 167) {
+    dots += 6;
+  }
+  if (registers.obj_ef) {
+    dots += ObjPenaltyDots();
+  }
+  return dots;
 }
 
-uint8_t read_vram(uint16_t addr) {
-  if (registers.attr_bank) {
-    return vram_bank1[addr - 0x8000];
+void EnterMode(PpuMode mode) {
+  registers.mode = mode;
+  UpdateStatLine();
+  switch (mode) {
+    case oam_scan:
+      if (CPU::OamDmaActive()) {
+        // OAM reads as 0xFF to the PPU while DMA owns it, so no OBJ is on the line.
+        memset(oam_buffer, 0, 0x28);
+        if (render_mode == pipelined_renderer) {
+          LogEmptyOamScan(registers.LY, registers.current_dot);
+        }
+      } else {
+        ScanOam(state);
+      }
+      // in order for window to turn on in a frame at one point WY must be
+      // equal to LY, and this condition is only checked during OAM scan.
+      if (registers.WY == registers.LY) {
+        registers.wy_eq = true;
+      }
+      registers.next_transition_dot = kOamScanDots;
+      break;
+    case draw:
+      if (render_mode == dot_renderer || render_mode == span_renderer) {
+        BuildObjLine(state);
+      }
+      if (render_mode == span_renderer) {
+        line_start_registers = registers;
+        memcpy(line_bg_cram, registers.bg_cram, sizeof(line_bg_cram));
+        memcpy(line_obj_cram, registers.obj_cram, sizeof(line_obj_cram));
+        line_start_registers.bg_cram = line_bg_cram;
+        line_start_registers.obj_cram = line_obj_cram;
+        line_write_count = 0;
+      }
+      registers.next_transition_dot = kOamScanDots + DrawDots();
+      break;
+    case hblank:
+      if (render_mode == scanline_renderer) {
+        DrawScanline(state);
+      } else if (render_mode == span_renderer) {
+        DrawQueuedLine();
+      }
+      if (registers.hdma_started) {
+        // transfer 0x10 bytes as part of transfer.
+        HdmaTransfer();
+      }
+      registers.next_transition_dot = 0;
+      break;
+    case vblank:
+      if (render_mode != pipelined_renderer) {
+        PublishDrawnFrame(state, CPU::Clock());
+      }
+      SetVblankInterrupt();
+      registers.next_transition_dot = 0;
+      break;
   }
-  return vram[addr - 0x8000];
 }
 
-uint8_t write_vram(uint16_t addr, uint8_t val) {
-  if (registers.attr_bank) {
-    vram_bank1[addr - 0x8000] = val;
-    return vram_bank1[addr - 0x8000];
+// The LCD goes blank and the PPU stops at LY 0 in mode 0 until it is turned
+// on again.
+void TurnOff() {
+  ResetFrameState();
+  registers.current_dot = 0;
+  registers.mode = hblank;
+  registers.stat_line = false;
+  CPU::SetPpuEnabled(false);
+  ClearFrame(state);
+  if (render_mode != pipelined_renderer) {
+    PublishDrawnFrame(state, CPU::Clock());
   }
-  vram[addr - 0x8000] = val;
-  return vram[addr - 0x8000];
 }
 
-PpuMode GetMode() {
-  if (registers.LY > 143) {
-    return PpuMode::vblank;
+// The PPU restarts at dot 0 of LY 0. That first line has no OAM scan, it
+// stays in mode 0 until mode 3 starts at the usual dot.
+void TurnOn() {
+  registers.current_dot = 0;
+  registers.next_transition_dot = kOamScanDots;
+  memset(oam_buffer, 0, 0x28);
+  registers.ly_eq = registers.LY == registers.LYC;
+  UpdateStatLine();
+  CPU::SetPpuEnabled(true);
+  if (render_mode == pipelined_renderer) {
+    LogClock(registers.LY, registers.current_dot, CPU::Clock());
   }
-  if (current_dot <= 80) {
-    return PpuMode::oam_scan;
+}
+
+// Move on to the mode that starts at the current dot.
+void Transition() {
+  if (registers.LY > 143) {
+    if (registers.mode != vblank) {
+      EnterMode(vblank);
+    }
+    return;
   }
-  // TODO: at some point, for games which require accurate timeing we will
-  // need to consider adding OBJ penalties. And making this mode variable.
-  if (current_dot < 252) {
-    return PpuMode::draw;
+  switch (registers.mode) {
+    case hblank:
+      if (registers.current_dot == kOamScanDots) {
+        // first line after the LCD was turned on.
+        EnterMode(draw);
+      } else {
+        EnterMode(oam_scan);
+      }
+      break;
+    case vblank:
+      EnterMode(oam_scan);
+      break;
+    case oam_scan:
+      EnterMode(draw);
+      break;
+    case draw:
+      EnterMode(hblank);
+      break;
   }
-  return PpuMode::hblank;
 }
 
-void SetInterruptIfNeeded(PpuMode mode) {
-  if (registers.mode0_stat && mode == hblank) {
-    SetStatInterrupt();
-  } else if (registers.mode1_stat && mode == vblank) {
-    SetStatInterrupt();
-  } else if (registers.mode2_stat && mode == oam_scan) {
-    SetStatInterrupt();
-  }
+}  // namespace
+
+void set_debug(bool setting) {
+  debug = setting;
 }
 
-void ScanOam() {
-  // clear old buffer
-  for (int i = 0; i < 0x28; ++i) {
-    oam_buffer[i] = 0;
-  }
-  int oam_buffer_idx = 0;
+void invalidate_caches() {
+  MarkAllTilesDirty(tile_cache);
+  UpdatePaletteEntries(registers, color_profile, 0, kPaletteEntries);
+  ResyncWorker();
+}
 
-  for (int i = 0; i < 0xA0 && oam_buffer_idx < 0x28; i += 4) {
-    int row = state.oam[i];
-    if (!state.registers.obj_sz) {
-      row -= 8;
-    }
-    int row_low = state.oam[i] - 16;
-    if (registers.LY >= row_low && registers.LY < row) {
-      oam_buffer[oam_buffer_idx++] = state.oam[i];
-      oam_buffer[oam_buffer_idx++] = state.oam[i + 1];
-      oam_buffer[oam_buffer_idx++] = state.oam[i + 2];
-      oam_buffer[oam_buffer_idx++] = state.oam[i + 3];
-    }
+void SaveState(Registers* out) {
+  *out = registers;
+}
+
+void LoadState(const Registers& in) {
+  registers = in;
+  active_vram = registers.attr_bank ? vram_bank1 : vram;
+  invalidate_caches();
+}
+
+void set_render_mode(RenderMode mode) {
+  if (render_mode == pipelined_renderer && mode != pipelined_renderer) {
+    StopWorker();
   }
+  render_mode = mode;
+  ResyncWorker();
+}
+
+uint8_t read_vram(uint16_t addr) {
+  return active_vram[addr - 0x8000];
+}
+
+uint8_t write_vram(uint16_t addr, uint8_t val) {
+  active_vram[addr - 0x8000] = val;
+  MarkTilesDirty(tile_cache, ActiveVramBank(), addr - 0x8000, 1);
+  LogDrawingWrite(addr, val);
+  return val;
 }
 
 void Step() {
@@ -209,36 +563,12 @@ void Step() {
     return;
   }
   IncrementPosition();
-  PpuMode new_mode = GetMode();
-  if (new_mode != registers.mode) {
-    SetInterruptIfNeeded(new_mode);
-    registers.mode = new_mode;
-    if (new_mode == vblank) {
-      if (registers.ppu_enable) GUI::UpdateTexture(pixels);
-      SetVblankInterrupt();
-    } else if (new_mode == hblank && registers.hdma_transfer) {
-      // transfer 0x10 bytes as part of transfer.
-      HdmaTransfer();
-    } else if (new_mode == oam_scan) {
-      ScanOam();
-      // in order for window to turn on in a frame at one point WY must be
-      // equal to LY, and this condition is only checked during OAM scan.
-      if (registers.WY == registers.LY) {
-        registers.wy_eq = true;
-      }
-    }
+  if (registers.current_dot == registers.next_transition_dot) {
+    Transition();
   }
-  switch (registers.mode) {
-    case oam_scan:
-      // TODO: consider having a OAM buffer and drawing OBJs realistically
-      break;
-    case draw:
-      DrawDot(state);
-      break;
-    case hblank:
-    case vblank:
-      // no-op
-      break;
+  // OAM is scanned in one go when the mode starts, only mode 3 has per dot work.
+  if (registers.mode == draw && render_mode == dot_renderer) {
+    DrawDot(state);
   }
 }
 
@@ -248,28 +578,31 @@ void dot() {
 }
 
 uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
+  if (m == CPU::write && IsDrawingRegister(addr)) {
+    LogDrawingWrite(addr, val);
+  }
+  if (m == CPU::write && IsLineRegister(addr)) {
+    QueueLineWrite(addr, val);
+  }
   switch (addr) {
     case 0xFF40:
       if (m == CPU::write) {
         bool old_ppu = registers.ppu_enable;
         registers.LCDC = val;
-        if (!registers.ppu_enable) {
-          printf("turning off ppu %X\n", registers.LCDC);
-          ResetFrameState();
-          registers.current_dot = 0;
-          registers.mode = hblank;
-        } else if (!old_ppu) {
-          printf("turning on ppu %X\n", registers.LCDC);
+        if (old_ppu && !registers.ppu_enable) {
+          TurnOff();
+        } else if (!old_ppu && registers.ppu_enable) {
+          TurnOn();
         }
       }
       return registers.LCDC;
     case 0xFF41:
       if (m == CPU::write) {
-        printf("writing to STAT %X\n", val);
-        val &= 0xFC;
-        registers.STAT |= val;
+        // the mode and LY=LYC bits are read only.
+        registers.STAT = (registers.STAT & 0x07) | (val & 0x78);
+        UpdateStatLine();
       }
-      return registers.STAT;
+      return registers.STAT | 0x80;
     case 0xFF42:
       if (m == CPU::write) {
         registers.SCY = val;
@@ -285,6 +618,8 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
     case 0xFF45:
       if (m == CPU::write) {
         registers.LYC = val;
+        registers.ly_eq = registers.LY == registers.LYC;
+        UpdateStatLine();
       }
       return registers.LYC;
     case 0xFF46:
@@ -295,16 +630,19 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
     case 0xFF47:
       if (m == CPU::write) {
         registers.BGP = val;
+        UpdateDmgPalette(registers, color_profile, 0);
       }
       return registers.BGP;
     case 0xFF48:
       if (m == CPU::write) {
         registers.OBP0 = val;
+        UpdateDmgPalette(registers, color_profile, kObjPaletteEntries);
       }
       return registers.OBP0;
     case 0xFF49:
       if (m == CPU::write) {
         registers.OBP1 = val;
+        UpdateDmgPalette(registers, color_profile, kObjPaletteEntries + 4);
       }
       return registers.OBP1;
     case 0xFF4A:
@@ -327,6 +665,7 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
     case 0xFF4F:
       if (m == CPU::write) {
         registers.attr_bank = val & 1;
+        active_vram = registers.attr_bank ? vram_bank1 : vram;
       }
       return registers.attr_bank;
     case 0xFF51:
@@ -334,44 +673,46 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
         registers.vram_dma_source &= 0x00FF;
         registers.vram_dma_source |= val << 8;
       }
-      printf("writing to $FF51 val %X\n", val);
-      return 0;
+      return 0xFF;
     case 0xFF52:
       if (m == CPU::write) {
         val &= 0xF0;
         registers.vram_dma_source &= 0xFF00;
         registers.vram_dma_source |= val;
       }
-      printf("writing to $FF52 val %X\n", val);
-      return 0;
+      return 0xFF;
     case 0xFF53:
       if (m == CPU::write) {
+        // only 0x8000-0x9FF0 can be a destination, upper bits are ignored.
         registers.vram_dma_dest &= 0x00FF;
-        registers.vram_dma_dest |= val << 8;
+        registers.vram_dma_dest |= (val & 0x1F) << 8;
       }
-      printf("writing to $FF53 val %X\n", val);
-      return 0;
+      return 0xFF;
     case 0xFF54:
       if (m == CPU::write) {
         val &= 0xF0;
         registers.vram_dma_dest &= 0xFF00;
         registers.vram_dma_dest |= val;
       }
-      printf("writing to $FF54 val %X\n", val);
-      return 0;
+      return 0xFF;
     case 0xFF55:
       if (m == CPU::read) {
+        if (registers.hdma_started) {
+          // bit 7 reads 0 while an HBlank transfer is active.
+          return registers.dma_length;
+        }
         if (registers.dma_status == 0) {
           return 0xFF;
         }
       } else {
         if (registers.hdma_started && (val & 0x80) == 0) {
+          // stopping an HBlank transfer keeps the remaining length readable.
           registers.hdma_started = false;
-          registers.dma_status = 0;
-          return 0;
+          registers.dma_status = 0x80 | registers.dma_length;
+          return registers.dma_status;
         }
         registers.dma_status = val;
-        int length = ((val & 0x74) + 1) * 0x10;
+        int length = (registers.dma_length + 1) * 0x10;
         if (!registers.hdma_transfer) {
           VramDmaTransfer(length);
         } else {
@@ -387,6 +728,7 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
     case 0xFF69:
       if (m == CPU::write) {
         registers.bg_cram[registers.bg_color_addr] = val;
+        UpdateCgbPaletteColor(registers, color_profile, 0, registers.bg_color_addr);
         if (registers.bg_auto_increment_color_addr) {
           registers.bg_color_addr++;
         }
@@ -401,12 +743,13 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
     case 0xFF6B:
       if (m == CPU::write) {
         registers.obj_cram[registers.obj_color_addr] = val;
+        UpdateCgbPaletteColor(registers, color_profile, kObjPaletteEntries, registers.obj_color_addr);
         if (registers.obj_auto_increment_color_addr) {
           registers.obj_color_addr++;
         }
         return val;
       }
-      return registers.bg_cram[registers.obj_color_addr];
+      return registers.obj_cram[registers.obj_color_addr];
     default:
       return 0x00;
   }
@@ -414,6 +757,7 @@ uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val) {
 
 uint8_t write_oam(uint16_t addr, uint8_t val) {
   oam[addr - kOamOffset] = val;
+  LogDrawingWrite(addr, val);
   return val;
 }
 
@@ -423,6 +767,23 @@ uint8_t read_oam(uint16_t addr) {
 
 void set_cgb_mode(bool cgb_mode) {
   registers.cgb_mode = cgb_mode;
+  UpdatePaletteEntries(registers, color_profile, 0, kPaletteEntries);
+  ResyncWorker();
+}
+
+void set_frame_format(FrameFormat format) {
+  state.indexed = format == indexed_pixels ? &indexed : nullptr;
+  ResyncWorker();
+}
+
+const IndexedFrame &indexed_frame() {
+  return indexed;
+}
+
+void set_color_profile(ColorProfile profile) {
+  color_profile = profile;
+  UpdatePaletteEntries(registers, color_profile, 0, kPaletteEntries);
+  ResyncWorker();
 }
 
 uint32_t ToRgb888(Color c) {
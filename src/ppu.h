@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include "cpu.h"
+#include "memory_arena.h"
+#include "rendering/tile_cache.h"
 
 namespace PPU {
 
@@ -17,8 +19,25 @@ constexpr uint32_t kBlack = 0;
 
 constexpr uint16_t kOamOffset = 0xFE00;
 
+constexpr int kDotsPerLine = 456;
+// Mode 2 length, mode 3 starts at this dot of every visible line.
+constexpr int kOamScanDots = 80;
+
 constexpr uint32_t kGreyPalette[4]{kWhite, kLightGrey, kDarkGrey, kBlack};
 
+// Layout of the converted palette table: 8 BG palettes of 4 colors followed
+// by 8 OBJ palettes. DMG uses BG palette 0 for BGP and OBJ palettes 0 and 1
+// for OBP0 and OBP1.
+constexpr int kObjPaletteEntries = 32;
+constexpr int kPaletteEntries = 64;
+
+enum ColorProfile {
+  // CGB colors with every channel scaled to 8 bits as is.
+  raw_colors,
+  // Mix the channels the way the CGB LCD blends them, less saturated.
+  lcd_colors
+};
+
 union SpriteAttributes {
   struct {
     // CGB select palette
@@ -37,12 +56,11 @@ union SpriteAttributes {
   uint8_t attr;
 };
 
-struct ObjTileData {
-  uint8_t obj_step;
-  uint8_t obj_pos;
-  uint8_t obj_low;
-  uint8_t obj_high;
-  SpriteAttributes obj_attrs;
+// OBJ pixels of the current line, decoded once per line from the OAM buffer.
+struct ObjLine {
+  // color index of the OBJ drawn at each x, 0 where there is none.
+  uint8_t color[160];
+  SpriteAttributes attrs[160];
 };
 
 union BgWindowAttributes {
@@ -101,6 +119,30 @@ enum PpuMode {
   hblank, vblank, oam_scan, draw
 };
 
+enum RenderMode {
+  // Draw every dot while in mode 3, needed for games with mid line effects.
+  dot_renderer,
+  // Compose the whole line when mode 3 ends, using the registers at that time.
+  scanline_renderer,
+  // Draw every dot on a worker thread which replays a log of the writes the
+  // CPU made, the emulation thread only keeps the PPU timing.
+  pipelined_renderer,
+  // Queue the register writes made during mode 3 with the dot they happened
+  // at and draw the line when mode 3 ends, in spans of pixels split at those
+  // writes. Follows mid line effects like the dot renderer.
+  span_renderer
+};
+
+enum FrameFormat {
+  // RGB888 host pixels, what the GUI shows.
+  rgb_pixels,
+  // One palette table entry per pixel plus the palettes of its lines, see
+  // IndexedFrame.
+  indexed_pixels
+};
+
+struct IndexedFrame;
+
 struct Registers {
   /* LCD Control Registers */
   union {
@@ -161,18 +203,20 @@ struct Registers {
   bool wy_eq;
   bool wx_eq;
   int current_dot;
+  // dot of the current line where the next mode change happens, 0 for the
+  // start of the next line.
+  int next_transition_dot;
+  // OR of all enabled STAT interrupt sources, the interrupt fires when it rises.
+  bool stat_line;
   int x_pos;
   int bg_step;
-  int obj_step;
 
   /* FIFO data */
   Palette background_pallete;
   Palette obj_pallete;
-  uint8_t bg_low;
-  uint8_t bg_high;
+  // decoded row of the current BG/window tile, already X-flipped.
+  const uint8_t* bg_row;
   BgWindowAttributes bg_attrs;
-  uint8_t obj_low;
-  uint8_t obj_high;
   SpriteAttributes obj_attrs;
 
 
@@ -244,7 +288,7 @@ struct Registers {
     uint8_t bcps;
   };
 
-  uint8_t* bg_cram = new uint8_t[64];
+  uint8_t* bg_cram = Memory::arena.bg_cram;
 
   // Object color palette data
   union {
@@ -256,7 +300,11 @@ struct Registers {
     uint8_t ocps;
   };
 
-  uint8_t* obj_cram = new uint8_t[64];
+  uint8_t* obj_cram = Memory::arena.obj_cram;
+
+  // Every palette color already converted to host pixels, only updated when
+  // a palette register is written.
+  uint32_t palette_rgb[kPaletteEntries];
 
   Registers() = default;
 };
@@ -270,6 +318,10 @@ struct PpuState {
   uint8_t* oam;
   uint8_t* oam_buffer;
   uint32_t* pixels;
+  // When set, the renderers draw palette entries here instead of into pixels.
+  IndexedFrame* indexed;
+  ObjLine* obj_line;
+  TileCache* tile_cache;
 };
 
 uint8_t read_vram(uint16_t addr);
@@ -286,8 +338,24 @@ void dot();
 
 uint8_t access_registers(CPU::mode m, uint16_t addr, uint8_t val = 0);
 
+// Drop everything derived from VRAM and palette memory, for when it was
+// replaced wholesale.
+void invalidate_caches();
+
+// Registers, including the VRAM DMA in progress, for save states. LoadState
+// maps the VRAM bank they select and redecodes the caches, call it after the
+// arena has been restored.
+void SaveState(Registers* out);
+void LoadState(const Registers& in);
+
 void set_debug(bool setting);
+void set_render_mode(RenderMode mode);
 void set_cgb_mode(bool cgb_mode);
+void set_color_profile(ColorProfile profile);
+void set_frame_format(FrameFormat format);
+
+// Frame drawn by the dot and scanline renderers in indexed_pixels format.
+const IndexedFrame& indexed_frame();
 
 }  // namespace PPU
 
@@ -4,7 +4,13 @@
 
 #include "ppu.h"
 
+#include <cstring>
+#include <set>
+#include <vector>
 #include <gtest/gtest.h>
+#include "cpu.h"
+#include "memory_arena.h"
+#include "ppu_worker.h"
 
 namespace PPU {
 namespace {
@@ -34,5 +40,220 @@ TEST(ColorPalette, fromVal) {
   EXPECT_EQ(c.red(), 0x1F);
 }
 
+// Random scene with the window and OBJs on, run for two frames. The tile maps
+// come in by general DMA. With raster_writes scroll, palette, window and LCDC
+// registers are rewritten mid line, and an HBlank DMA replaces tile data
+// during the second frame. In CGB mode palette memory is rewritten as well.
+std::vector<uint32_t> DrawFrames(RenderMode mode, bool raster_writes, bool cgb_mode = false) {
+  CPU::InitializeRegisters(cgb_mode);
+  set_render_mode(mode);
+  uint32_t seed = 1;
+  auto random = [&seed] {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<uint8_t>(seed >> 16);
+  };
+  for (int addr = 0x8000; addr < 0x9800; ++addr) {
+    CPU::access<CPU::write>(addr, random());
+  }
+  for (int addr = 0xC000; addr < 0xC800; ++addr) {
+    CPU::access<CPU::write>(addr, random());
+  }
+  CPU::access<CPU::write>(0xFF51, 0xC0);
+  CPU::access<CPU::write>(0xFF52, 0x00);
+  CPU::access<CPU::write>(0xFF53, 0x18);
+  CPU::access<CPU::write>(0xFF54, 0x00);
+  CPU::access<CPU::write>(0xFF55, 0x7F);
+  for (int addr = 0xFE00; addr < 0xFEA0; ++addr) {
+    CPU::access<CPU::write>(addr, random());
+  }
+  CPU::access<CPU::write>(0xFF40, 0xF3);
+  CPU::access<CPU::write>(0xFF4A, 20);
+  CPU::access<CPU::write>(0xFF4B, 47);
+  CPU::access<CPU::write>(0xFF42, 13);
+  CPU::access<CPU::write>(0xFF43, 37);
+  CPU::access<CPU::write>(0xFF47, 0xE4);
+  CPU::access<CPU::write>(0xFF48, 0xD2);
+  CPU::access<CPU::write>(0xFF49, 0x1B);
+  std::vector<uint16_t> raster_registers{0xFF42, 0xFF43, 0xFF47, 0xFF48, 0xFF4B, 0xFF40};
+  if (cgb_mode) {
+    CPU::access<CPU::write>(0xFF68, 0x80);
+    CPU::access<CPU::write>(0xFF6A, 0x80);
+    for (int i = 0; i < 0x40; ++i) {
+      CPU::access<CPU::write>(0xFF69, random());
+      CPU::access<CPU::write>(0xFF6B, random());
+    }
+    raster_registers.insert(raster_registers.end(), {0xFF68, 0xFF69, 0xFF6A, 0xFF6B});
+  }
+  for (int i = 0; i < 2 * 70224; ++i) {
+    if (raster_writes && i == 70224) {
+      CPU::access<CPU::write>(0xFF51, 0xC4);
+      CPU::access<CPU::write>(0xFF52, 0x00);
+      CPU::access<CPU::write>(0xFF53, 0x08);
+      CPU::access<CPU::write>(0xFF54, 0x00);
+      CPU::access<CPU::write>(0xFF55, 0xBF);
+    }
+    if (raster_writes && i % 37 == 0) {
+      uint16_t addr = raster_registers[(i / 37) % raster_registers.size()];
+      // keep the LCD on, only flip the other LCDC bits.
+      CPU::access<CPU::write>(addr, addr == 0xFF40 ? random() | 0x80 : random());
+    }
+    dot();
+  }
+  const uint32_t *frame = Memory::arena.pixels;
+  if (mode == pipelined_renderer) {
+    FlushWorker();
+    frame = WorkerPixels();
+  }
+  std::vector<uint32_t> pixels(frame, frame + Memory::kScreenWidth * Memory::kScreenHeight);
+  set_render_mode(dot_renderer);
+  return pixels;
 }
+
+TEST(ScanlineRenderer, MatchesDotRendererOnStaticLines) {
+  std::vector<uint32_t> dots = DrawFrames(dot_renderer, false);
+  std::vector<uint32_t> scanlines = DrawFrames(scanline_renderer, false);
+  EXPECT_EQ(dots, scanlines);
+  // all four shades show up, the scene is not blank.
+  EXPECT_EQ(std::set<uint32_t>(dots.begin(), dots.end()).size(), 4u);
+}
+
+TEST(SpanRenderer, MatchesDotRendererWithMidLineWrites) {
+  std::vector<uint32_t> dots = DrawFrames(dot_renderer, true);
+  std::vector<uint32_t> spans = DrawFrames(span_renderer, true);
+  EXPECT_EQ(dots, spans);
+}
+
+TEST(SpanRenderer, MatchesDotRendererWithMidLinePaletteMemoryWrites) {
+  std::vector<uint32_t> dots = DrawFrames(dot_renderer, true, true);
+  std::vector<uint32_t> spans = DrawFrames(span_renderer, true, true);
+  EXPECT_EQ(dots, spans);
+}
+
+// DMG scene with OBJs on lines 58-66, run with the clock from LCD on to the
+// end of the second frame. With start_dma an OAM DMA of the same OBJs starts
+// on line 60 of that frame, OAM scans while it runs find no OBJs.
+std::vector<uint32_t> DrawFramesWithOamDma(RenderMode mode, bool start_dma) {
+  CPU::InitializeRegisters(false);
+  set_render_mode(mode);
+  CPU::access<CPU::write>(0xFF40, 0x00);
+  uint32_t seed = 1;
+  auto random = [&seed] {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<uint8_t>(seed >> 16);
+  };
+  for (int addr = 0x8000; addr < 0xA000; ++addr) {
+    CPU::access<CPU::write>(addr, random());
+  }
+  for (int i = 0; i < 40; ++i) {
+    uint8_t obj[]{static_cast<uint8_t>(16 + 58 + i % 5), static_cast<uint8_t>(8 + i * 4), random(), random()};
+    for (int j = 0; j < 4; ++j) {
+      CPU::access<CPU::write>(0xFE00 + i * 4 + j, obj[j]);
+      CPU::access<CPU::write>(0xC100 + i * 4 + j, obj[j]);
+    }
+  }
+  CPU::access<CPU::write>(0xFF47, 0xE4);
+  CPU::access<CPU::write>(0xFF48, 0xD2);
+  CPU::access<CPU::write>(0xFF49, 0x1B);
+  CPU::access<CPU::write>(0xFF40, 0x93);
+  // an M-cycle is 4 dots.
+  for (int i = 0; i < (70224 + 60 * 456) / 4; ++i) {
+    CPU::Tick();
+  }
+  if (start_dma) {
+    CPU::access<CPU::write>(0xFF46, 0xC1);
+  }
+  for (int i = (70224 + 60 * 456) / 4; i < (70224 + 145 * 456) / 4; ++i) {
+    CPU::Tick();
+  }
+  const uint32_t *frame = Memory::arena.pixels;
+  if (mode == pipelined_renderer) {
+    FlushWorker();
+    frame = WorkerPixels();
+  }
+  std::vector<uint32_t> pixels(frame, frame + Memory::kScreenWidth * Memory::kScreenHeight);
+  set_render_mode(dot_renderer);
+  return pixels;
+}
+
+TEST(PipelinedRenderer, MatchesDotRendererWithMidLineWrites) {
+  std::vector<uint32_t> dots = DrawFrames(dot_renderer, true);
+  std::vector<uint32_t> pipelined = DrawFrames(pipelined_renderer, true);
+  EXPECT_EQ(dots, pipelined);
+}
+
+TEST(PipelinedRenderer, MatchesDotRendererDuringOamDma) {
+  std::vector<uint32_t> dots = DrawFramesWithOamDma(dot_renderer, true);
+  std::vector<uint32_t> pipelined = DrawFramesWithOamDma(pipelined_renderer, true);
+  EXPECT_EQ(dots, pipelined);
+  // the DMA does hide OBJs, otherwise the scene proves nothing.
+  EXPECT_NE(dots, DrawFramesWithOamDma(dot_renderer, false));
 }
+
+// CGB with NOPs from 0xC000 for the CPU to run during a VRAM DMA, and 0x40
+// bytes of source data at 0xD000.
+void SetUpVramDma(bool double_speed) {
+  CPU::InitializeRegisters(true);
+  CPU::SetDoubleSpeed(double_speed);
+  CPU::access<CPU::write>(0xFFFF, 0);
+  for (int addr = 0xC000; addr < 0xD000; ++addr) {
+    CPU::access<CPU::write>(addr, 0x00);
+  }
+  for (int i = 0; i < 0x40; ++i) {
+    CPU::access<CPU::write>(0xD000 + i, i + 1);
+  }
+  CPU::access<CPU::write>(0xFF51, 0xD0);
+  CPU::access<CPU::write>(0xFF52, 0x00);
+  CPU::access<CPU::write>(0xFF53, 0x00);
+  CPU::access<CPU::write>(0xFF54, 0x00);
+  CPU::GetRegisters().PC = 0xC000;
+}
+
+// T-cycles the CPU spent stalled since start, the clock minus the NOPs it
+// ran from 0xC000.
+uint64_t StalledCycles(uint64_t start, bool double_speed) {
+  uint64_t nops = CPU::GetRegisters().PC - 0xC000;
+  return CPU::Clock() - start - nops * (double_speed ? 2 : 4);
+}
+
+// A 0x10 byte block takes 8 M-cycles at normal speed, 16 in double speed,
+// the same 32 T-cycles of the normal speed clock either way.
+constexpr uint64_t kBlockCycles = 32;
+
+TEST(VramDma, GeneralDmaStallsPerBlock) {
+  for (bool double_speed : {false, true}) {
+    SetUpVramDma(double_speed);
+    uint64_t start = CPU::Clock();
+    // 4 blocks.
+    CPU::access<CPU::write>(0xFF55, 0x03);
+    // the whole stall passes before the first NOP.
+    CPU::ProcessInstruction();
+    while (CPU::GetRegisters().PC == 0xC000) {
+      CPU::ProcessInstruction();
+    }
+    EXPECT_EQ(CPU::access<CPU::read>(0xFF55), 0xFF);
+    EXPECT_EQ(StalledCycles(start, double_speed), 4 * kBlockCycles) << "double speed " << double_speed;
+  }
+  CPU::SetDoubleSpeed(false);
+}
+
+TEST(VramDma, HblankDmaStallsPerBlock) {
+  for (bool double_speed : {false, true}) {
+    SetUpVramDma(double_speed);
+    uint64_t start = CPU::Clock();
+    // 3 blocks, one per HBlank.
+    CPU::access<CPU::write>(0xFF55, 0x82);
+    for (int i = 0; i < 4000 && CPU::access<CPU::read>(0xFF55) != 0xFF; ++i) {
+      CPU::ProcessInstruction();
+    }
+    ASSERT_EQ(CPU::access<CPU::read>(0xFF55), 0xFF);
+    // let the stall of the last block run out.
+    for (int i = 0; i < 20; ++i) {
+      CPU::ProcessInstruction();
+    }
+    EXPECT_EQ(StalledCycles(start, double_speed), 3 * kBlockCycles) << "double speed " << double_speed;
+  }
+  CPU::SetDoubleSpeed(false);
+}
+
+}  // namespace
+}  // namespace PPU
@@ -0,0 +1,387 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#include "ppu_worker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "gui.h"
+#include "spsc_queue.h"
+#include "rendering/draw.h"
+#include "rendering/indexed_frame.h"
+#include "rendering/palette.h"
+
+namespace PPU {
+namespace {
+
+// Enough for a frame of heavy VRAM streaming, the CPU waits when it is full.
+constexpr size_t kLogCapacity = 1 << 16;
+// Data of DMA copies, a few times the largest page sized run CopyToVram logs.
+constexpr size_t kBlockDataCapacity = 1 << 14;
+// Log entries with this address only move the worker's position.
+constexpr uint16_t kAdvanceOnly = 0;
+// Log entries with this address empty the OAM buffer the worker just scanned.
+constexpr uint16_t kEmptyOamScan = 1;
+// Log entries with this address set the worker's clock from block_data.
+constexpr uint16_t kSetClock = 2;
+// More than the CPU can write in a line, even in double speed mode.
+constexpr int kBatchSize = 256;
+
+struct LoggedWrite {
+  uint16_t addr;
+  uint16_t dot;
+  // Bytes of a copy waiting in block_data, 0 for a single write of val.
+  uint16_t length;
+  uint8_t val;
+  uint8_t line;
+};
+
+SpscQueue<LoggedWrite, kLogCapacity> write_log;
+SpscQueue<uint8_t, kBlockDataCapacity> block_data;
+// Entries pushed by the emulation thread and applied by the worker.
+uint64_t logged = 0;
+std::atomic<uint64_t> applied{0};
+
+// Entries of the current line on the emulation thread. They are published in
+// one go, so the threads trade the log's cache lines once a line instead of
+// on every write.
+LoggedWrite batch[kBatchSize];
+int batch_count = 0;
+
+/* Worker copy of everything the renderer reads */
+Registers registers;
+uint8_t vram[0x2000];
+uint8_t vram_bank1[0x2000];
+uint8_t *active_vram = vram;
+uint8_t oam[0xA0];
+uint8_t oam_buffer[0x28];
+uint8_t bg_cram[0x40];
+uint8_t obj_cram[0x40];
+uint32_t pixels[Memory::kScreenWidth * Memory::kScreenHeight];
+ObjLine obj_line{};
+TileCache tile_cache{};
+IndexedFrame indexed{};
+ColorProfile color_profile = raw_colors;
+// CPU clock of the dot drawn last, it moves one per dot while the LCD is on.
+uint64_t clock = 0;
+
+PpuState state{
+    .registers = registers,
+    .vram = vram,
+    .vram_bank1 = vram_bank1,
+    .oam = oam,
+    .oam_buffer = oam_buffer,
+    .pixels = pixels,
+    .indexed = nullptr,
+    .obj_line = &obj_line,
+    .tile_cache = &tile_cache,
+};
+
+void ResetFrameState() {
+  registers.LY = 0;
+  registers.WLY = 0;
+  registers.wy_eq = false;
+  registers.wx_eq = false;
+}
+
+// Same per dot rendering work as the dot renderer does in PPU::Step.
+void StepDot() {
+  ++clock;
+  if (++registers.current_dot == kDotsPerLine) {
+    registers.current_dot = 0;
+    registers.x_pos = 0;
+    if (registers.is_in_window) {
+      registers.WLY++;
+    }
+    registers.is_in_window = false;
+    if (++registers.LY == 154) {
+      ResetFrameState();
+    }
+  }
+  if (registers.LY > 143) {
+    if (registers.LY == 144 && registers.current_dot == 0) {
+      PublishDrawnFrame(state, clock);
+    }
+    return;
+  }
+  if (registers.current_dot == 0) {
+    ScanOam(state);
+    if (registers.WY == registers.LY) {
+      registers.wy_eq = true;
+    }
+  } else if (registers.current_dot == kOamScanDots) {
+    BuildObjLine(state);
+  }
+  if (registers.current_dot >= kOamScanDots) {
+    DrawDot(state);
+  }
+}
+
+void AdvanceTo(uint8_t line, uint16_t dot) {
+  while (registers.LY != line || registers.current_dot != dot) {
+    StepDot();
+  }
+}
+
+void WriteLcdc(uint8_t val) {
+  bool old_ppu = registers.ppu_enable;
+  registers.LCDC = val;
+  if (old_ppu && !registers.ppu_enable) {
+    ResetFrameState();
+    registers.current_dot = 0;
+    registers.x_pos = 0;
+    registers.is_in_window = false;
+    ClearFrame(state);
+    PublishDrawnFrame(state, clock);
+  } else if (!old_ppu && registers.ppu_enable) {
+    // the first line after turning on has no OAM scan.
+    memset(oam_buffer, 0, sizeof(oam_buffer));
+  }
+}
+
+// Mirrors the register semantics of PPU::access_registers for the registers
+// that change what is drawn.
+void Apply(const LoggedWrite &write) {
+  uint16_t addr = write.addr;
+  uint8_t val = write.val;
+  if (addr >= 0x8000 && addr < 0xA000) {
+    active_vram[addr - 0x8000] = val;
+    MarkTilesDirty(tile_cache, active_vram == vram_bank1, addr - 0x8000, 1);
+    return;
+  }
+  if (addr >= kOamOffset && addr < kOamOffset + 0xA0) {
+    oam[addr - kOamOffset] = val;
+    return;
+  }
+  switch (addr) {
+    case 0xFF40:
+      WriteLcdc(val);
+      break;
+    case 0xFF42:
+      registers.SCY = val;
+      break;
+    case 0xFF43:
+      registers.SCX = val;
+      break;
+    case 0xFF47:
+      registers.BGP = val;
+      UpdateDmgPalette(registers, color_profile, 0);
+      break;
+    case 0xFF48:
+      registers.OBP0 = val;
+      UpdateDmgPalette(registers, color_profile, kObjPaletteEntries);
+      break;
+    case 0xFF49:
+      registers.OBP1 = val;
+      UpdateDmgPalette(registers, color_profile, kObjPaletteEntries + 4);
+      break;
+    case 0xFF4A:
+      registers.WY = val;
+      break;
+    case 0xFF4B:
+      registers.WX = val;
+      break;
+    case 0xFF4F:
+      active_vram = (val & 1) ? vram_bank1 : vram;
+      break;
+    case 0xFF68:
+      registers.bcps = val;
+      break;
+    case 0xFF69:
+      registers.bg_cram[registers.bg_color_addr] = val;
+      UpdateCgbPaletteColor(registers, color_profile, 0, registers.bg_color_addr);
+      if (registers.bg_auto_increment_color_addr) {
+        registers.bg_color_addr++;
+      }
+      break;
+    case 0xFF6A:
+      registers.ocps = val;
+      break;
+    case 0xFF6B:
+      registers.obj_cram[registers.obj_color_addr] = val;
+      UpdateCgbPaletteColor(registers, color_profile, kObjPaletteEntries, registers.obj_color_addr);
+      if (registers.obj_auto_increment_color_addr) {
+        registers.obj_color_addr++;
+      }
+      break;
+  }
+}
+
+// Copy of length bytes to VRAM or OAM at write.addr from block_data.
+void ApplyBlock(const LoggedWrite &write) {
+  uint8_t *dest;
+  if (write.addr >= kOamOffset) {
+    dest = oam + (write.addr - kOamOffset);
+  } else {
+    dest = active_vram + (write.addr - 0x8000);
+    MarkTilesDirty(tile_cache, active_vram == vram_bank1, write.addr - 0x8000, write.length);
+  }
+  // the data was pushed before the entry was published, it is all there.
+  block_data.PopSome(dest, write.length);
+}
+
+void Publish() {
+  const LoggedWrite *next = batch;
+  size_t left = batch_count;
+  while (left > 0) {
+    size_t pushed = write_log.PushSome(next, left);
+    next += pushed;
+    left -= pushed;
+    if (left > 0) {
+      std::this_thread::yield();
+    }
+  }
+  logged += batch_count;
+  batch_count = 0;
+}
+
+// Data for a log entry, pushed ahead of the entry itself.
+void PushBlockData(const uint8_t *data, int length) {
+  int pushed = 0;
+  while (true) {
+    pushed += block_data.PushSome(data + pushed, length - pushed);
+    if (pushed == length) {
+      return;
+    }
+    // the worker frees data as it reaches the entries already batched.
+    Publish();
+    std::this_thread::yield();
+  }
+}
+
+void Push(const LoggedWrite &write) {
+  if (batch_count == kBatchSize) {
+    Publish();
+  }
+  batch[batch_count++] = write;
+}
+
+struct Worker {
+  std::thread thread;
+  std::atomic<bool> stop_requested{false};
+
+  void Run() {
+    LoggedWrite writes[kBatchSize];
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+      size_t count = write_log.PopSome(writes, kBatchSize);
+      if (count == 0) {
+        // trailing by a little is the point, no need to spin for the CPU.
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+      for (size_t i = 0; i < count; ++i) {
+        const LoggedWrite &write = writes[i];
+        AdvanceTo(write.line, write.dot);
+        if (write.addr == kSetClock) {
+          block_data.PopSome(reinterpret_cast<uint8_t *>(&clock), sizeof(clock));
+        } else if (write.length != 0) {
+          ApplyBlock(write);
+        } else if (write.addr == kEmptyOamScan) {
+          memset(oam_buffer, 0, sizeof(oam_buffer));
+        } else if (write.addr != kAdvanceOnly) {
+          Apply(write);
+        }
+      }
+      applied.fetch_add(count, std::memory_order_release);
+    }
+  }
+
+  void Stop() {
+    if (thread.joinable()) {
+      stop_requested = true;
+      thread.join();
+      stop_requested = false;
+    }
+  }
+
+  ~Worker() {
+    Stop();
+  }
+};
+
+// Defined last so it is destroyed, and the thread stopped, before the state above.
+Worker worker;
+
+}  // namespace
+
+void StartWorker(const PpuState &source, int vram_bank, ColorProfile profile) {
+  worker.Stop();
+  LoggedWrite dropped{};
+  while (write_log.TryPop(dropped)) {
+  }
+  uint8_t dropped_data[256];
+  while (block_data.PopSome(dropped_data, sizeof(dropped_data)) != 0) {
+  }
+  batch_count = 0;
+  logged = 0;
+  applied = 0;
+
+  registers = source.registers;
+  registers.bg_cram = bg_cram;
+  registers.obj_cram = obj_cram;
+  memcpy(bg_cram, source.registers.bg_cram, sizeof(bg_cram));
+  memcpy(obj_cram, source.registers.obj_cram, sizeof(obj_cram));
+  memcpy(vram, source.vram, sizeof(vram));
+  memcpy(vram_bank1, source.vram_bank1, sizeof(vram_bank1));
+  memcpy(oam, source.oam, sizeof(oam));
+  memcpy(oam_buffer, source.oam_buffer, sizeof(oam_buffer));
+  memcpy(pixels, source.pixels, sizeof(pixels));
+  state.indexed = source.indexed ? &indexed : nullptr;
+  if (source.indexed) {
+    CopyIndexedFrame(*source.indexed, &indexed);
+  }
+  active_vram = vram_bank ? vram_bank1 : vram;
+  color_profile = profile;
+  clock = CPU::Clock();
+  MarkAllTilesDirty(tile_cache);
+
+  worker.thread = std::thread(&Worker::Run, &worker);
+}
+
+void StopWorker() {
+  worker.Stop();
+}
+
+void LogWrite(uint8_t line, uint16_t dot, uint16_t addr, uint8_t val) {
+  Push({.addr = addr, .dot = dot, .length = 0, .val = val, .line = line});
+  if (addr == 0xFF40) {
+    // while the LCD is off no line ends to publish the batch.
+    Publish();
+  }
+}
+
+void LogBlock(uint8_t line, uint16_t dot, uint16_t addr, const uint8_t *data, int length) {
+  PushBlockData(data, length);
+  Push({.addr = addr, .dot = dot, .length = static_cast<uint16_t>(length), .val = 0, .line = line});
+}
+
+void LogClock(uint8_t line, uint16_t dot, uint64_t clock) {
+  PushBlockData(reinterpret_cast<const uint8_t *>(&clock), sizeof(clock));
+  Push({.addr = kSetClock, .dot = dot, .length = sizeof(clock), .val = 0, .line = line});
+}
+
+void LogEmptyOamScan(uint8_t line, uint16_t dot) {
+  Push({.addr = kEmptyOamScan, .dot = dot, .length = 0, .val = 0, .line = line});
+}
+
+void LogAdvance(uint8_t line, uint16_t dot) {
+  Push({.addr = kAdvanceOnly, .dot = dot, .length = 0, .val = 0, .line = line});
+  Publish();
+}
+
+void FlushWorker() {
+  Publish();
+  while (applied.load(std::memory_order_acquire) != logged) {
+    std::this_thread::yield();
+  }
+}
+
+const uint32_t *WorkerPixels() {
+  return pixels;
+}
+
+}  // namespace PPU
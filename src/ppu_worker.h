@@ -0,0 +1,51 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#ifndef GB_EMU_SRC_PPU_WORKER_H_
+#define GB_EMU_SRC_PPU_WORKER_H_
+
+#include <cstdint>
+#include "ppu.h"
+
+// Pipelined renderer. The emulation thread logs every write that changes
+// what is drawn, stamped with the line and dot it happened at, and a worker
+// thread replays the log against its own copy of the PPU state, drawing dot
+// by dot a little behind the emulation. The log is handed over a line at a
+// time.
+namespace PPU {
+
+// Start the worker from a copy of state, restarting it if it is running.
+// Everything logged afterwards is relative to this copy.
+void StartWorker(const PpuState& state, int vram_bank, ColorProfile profile);
+
+void StopWorker();
+
+// Log a write to VRAM, OAM or a PPU register done after dot of line.
+void LogWrite(uint8_t line, uint16_t dot, uint16_t addr, uint8_t val);
+
+// Log a copy of length bytes from data to VRAM or OAM at addr, done after dot
+// of line. Takes one entry however long the copy is.
+void LogBlock(uint8_t line, uint16_t dot, uint16_t addr, const uint8_t* data, int length);
+
+// The LCD was turned on at dot of line, at CPU clock. The worker counts the
+// clock on from there to stamp the frames it publishes.
+void LogClock(uint8_t line, uint16_t dot, uint64_t clock);
+
+// The OAM scan at dot of line found no OBJs, OAM DMA kept the PPU from
+// reading OAM.
+void LogEmptyOamScan(uint8_t line, uint16_t dot);
+
+// Let the worker draw up to and including dot of line. Also hands it
+// everything logged since the last line.
+void LogAdvance(uint8_t line, uint16_t dot);
+
+// Wait for the worker to apply everything logged so far.
+void FlushWorker();
+
+// Frame the worker draws into, only stable after FlushWorker().
+const uint32_t* WorkerPixels();
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_PPU_WORKER_H_
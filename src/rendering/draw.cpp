@@ -2,15 +2,23 @@
 // Created by Brian Bonafilia on 11/10/24.
 //
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include "draw.h"
+#include "indexed_frame.h"
+#include "pixel_kernels.h"
+#include "tile_cache.h"
 #include "../gui.h"
+#include "../capture/frame_capture.h"
 
 namespace PPU {
 
 namespace {
 
+FrameObserver frame_observer = nullptr;
+
 bool RowOutOfBounds(int row) {
   return row < 0 || row > 143;
 }
@@ -57,7 +65,7 @@ void SetBgColorAttrs(const PpuState &state, int x_tile, int y_tile) {
   }
 }
 
-void SetWindowTileLowHigh(const PpuState &state) {
+void SetWindowTileRow(const PpuState &state) {
   int window_x = state.registers.x_pos + 7 - state.registers.WX;
   int window_y = state.registers.WLY;
   int x_tile = window_x / 8;
@@ -70,13 +78,9 @@ void SetWindowTileLowHigh(const PpuState &state) {
   if (state.registers.cgb_mode && state.registers.bg_attrs.flip_y) {
     tile_row = 7 - tile_row;
   }
-  uint8_t *bank = state.vram;
-  if (state.registers.bg_attrs.bank == 1) {
-    bank = state.vram_bank1;
-  }
   state.registers.bg_step = window_x % 8;
-  state.registers.bg_low = bank[tile_addr + tile_row * 2];
-  state.registers.bg_high = bank[tile_addr + tile_row * 2 + 1];
+  state.registers.bg_row = DecodedTileRow(state, state.registers.bg_attrs.bank, tile_addr + tile_row * 2,
+                                          state.registers.bg_attrs.flip_x);
 }
 
 ColorPalette GetColorPalette(const PpuState &state, SpriteAttributes attributes) {
@@ -125,109 +129,7 @@ int ObjSz(const PpuState &state) {
   return state.registers.obj_sz ? 15 : 7;
 }
 
-int GetObjColor(const ObjTileData data) {
-  int obj_color_idx = 0;
-  if (data.obj_step >= 0) {
-    uint8_t obj_mask = 0x80 >> data.obj_step;
-    if (data.obj_attrs.flip_x) {
-      obj_mask = 0x01 << data.obj_step;
-    }
-    if (obj_mask & data.obj_low) obj_color_idx++;
-    if (obj_mask & data.obj_high) obj_color_idx += 2;
-  }
-  return obj_color_idx;
-}
-
-int GetObjColor(const PpuState &state) {
-  int obj_color_idx = 0;
-  if (state.registers.obj_step >= 0) {
-    uint8_t obj_mask = 0x80 >> state.registers.obj_step;
-    if (state.registers.obj_attrs.flip_x) {
-      obj_mask = 0x01 << state.registers.obj_step;
-    }
-    if (obj_mask & state.registers.obj_low) obj_color_idx++;
-    if (obj_mask & state.registers.obj_high) obj_color_idx += 2;
-  }
-  return obj_color_idx;
-}
-
-ObjTileData GetObjData(const PpuState &state, int x, int y, int oam_index) {
-  ObjTileData data{};
-  int row = state.oam_buffer[oam_index] - 16;
-  int col = state.oam_buffer[oam_index + 1] - 8;
-  uint8_t tile_idx = state.oam_buffer[oam_index + 2];
-  SpriteAttributes attributes{.attr = state.oam_buffer[oam_index + 3]};
-  int sprite_addr = GetSpriteAddr(state, tile_idx);
-  int tile_row = y - row;
-  if (attributes.flip_y) {
-    tile_row = ObjSz(state) - tile_row;
-  }
-
-  data.obj_step = (x - col);
-  assert(data.obj_step >= 0 && data.obj_step < 8);
-  uint8_t *bank = state.vram;
-  if (attributes.bank == 1) {
-    bank = state.vram_bank1;
-  }
-  data.obj_pos = oam_index;
-  data.obj_low = bank[sprite_addr + tile_row * 2];
-  data.obj_high = bank[sprite_addr + tile_row * 2 + 1];
-  data.obj_attrs = attributes;
-  return data;
-}
-
-int FindObjOamIdx(const PpuState &state, int x, int y) {
-  for (int i = 0; i < 0x28; i += 4) {
-    int row = state.oam_buffer[i];
-    if (row == 0) {
-      return -1;
-    }
-    if (!state.registers.obj_sz) {
-      row -= 8;
-    }
-    int col = state.oam_buffer[i + 1];
-    int col_low = col - 8;
-    if (x >= col_low && x < col) {
-      ObjTileData data = GetObjData(state, x, y, i);
-      if (GetObjColor(data) > 0) {
-        return i;
-      }
-    }
-  }
-  return -1;
-}
-
-void SetObjTileLowHigh(const PpuState &state) {
-  int x = state.registers.x_pos;
-  int y = state.registers.LY;
-  int oam_index = FindObjOamIdx(state, x, y);
-  if (oam_index < 0) {
-    state.registers.obj_step = -1;
-    return;
-  }
-  int row = state.oam_buffer[oam_index] - 16;
-  int col = state.oam_buffer[oam_index + 1] - 8;
-  uint8_t tile_idx = state.oam_buffer[oam_index + 2];
-  SpriteAttributes attributes{.attr = state.oam_buffer[oam_index + 3]};
-  int sprite_addr = GetSpriteAddr(state, tile_idx);
-  int tile_row = y - row;
-  if (attributes.flip_y) {
-    tile_row = ObjSz(state) - tile_row;
-  }
-
-  state.registers.obj_step = (x - col);
-  assert(state.registers.obj_step >= 0 && state.registers.obj_step < 8);
-  uint8_t *bank = state.vram;
-  if (attributes.bank == 1) {
-    bank = state.vram_bank1;
-  }
-  state.registers.obj_low = bank[sprite_addr + tile_row * 2];
-  state.registers.obj_high = bank[sprite_addr + tile_row * 2 + 1];
-  state.registers.obj_attrs = attributes;
-
-}
-
-void SetBgTileLowHigh(const PpuState &state) {
+void SetBgTileRow(const PpuState &state) {
   int bg_x_pos = state.registers.SCX + state.registers.x_pos;
   int bg_y_pos = state.registers.SCY + state.registers.LY;
   bg_x_pos %= 256;
@@ -244,143 +146,112 @@ void SetBgTileLowHigh(const PpuState &state) {
     tile_row = 7 - tile_row;
   }
 
-  uint8_t *bank = state.vram;
-  if (state.registers.bg_attrs.bank == 1) {
-    bank = state.vram_bank1;
-  }
   state.registers.bg_step = bg_x_pos % 8;
-  state.registers.bg_low = bank[tile_addr + tile_row * 2];
-  state.registers.bg_high = bank[tile_addr + tile_row * 2 + 1];
+  state.registers.bg_row = DecodedTileRow(state, state.registers.bg_attrs.bank, tile_addr + tile_row * 2,
+                                          state.registers.bg_attrs.flip_x);
 }
 
-ColorPalette GetColorPalette(const PpuState &state, BgWindowAttributes attributes) {
-  ColorPalette color_palette{};
-  Color color{};
-  for (int i = 0; i < 4; ++i) {
-    color.val = state.registers.bg_cram[attributes.cgb_palette * 8 + i * 2] |
-        (state.registers.bg_cram[attributes.cgb_palette * 8 + i * 2 + 1] << 8);
-    switch (i) {
-      case 0:
-        color_palette.color0 = color;
-        break;
-      case 1:
-        color_palette.color1 = color;
-        break;
-      case 2:
-        color_palette.color2 = color;
-        break;
-      case 3:
-        color_palette.color3 = color;
-        break;
-    }
+// Pick between the BG/window and OBJ color for a pixel and return its entry
+// in the palette table.
+int MixEntry(const Registers &registers, int color_idx, BgWindowAttributes bg_attrs, int obj_color_idx,
+             SpriteAttributes obj_attrs) {
+  if (!registers.cgb_mode && !registers.bgw_ef) {
+    color_idx = 0;
   }
-  return color_palette;
-}
 
-void PushBgWindowColorPixel(int pixel, int val, ColorPalette color_palette, uint32_t *pixels) {
-  switch (val) {
-    case 0:
-      pixels[pixel] = ToRgb888(color_palette.color0);
-      break;
-    case 1:
-      pixels[pixel] = ToRgb888(color_palette.color1);
-      break;
-    case 2:
-      pixels[pixel] = ToRgb888(color_palette.color2);
-      break;
-    case 3:
-      pixels[pixel] = ToRgb888(color_palette.color3);
-      break;
-    default:
-      assert(false);
+  if (!registers.obj_ef) {
+    obj_color_idx = 0;
   }
-}
 
-void PushBgPixel(int pixel, int color_idx, const PpuState &state) {
-  if (state.registers.cgb_mode) {
-    PushBgWindowColorPixel(pixel, color_idx, GetColorPalette(state, state.registers.bg_attrs), state.pixels);
+  bool obj_drawn;
+  if (obj_color_idx == 0) {
+    obj_drawn = false;
+  } else if (registers.cgb_mode && !registers.bgw_ef) {
+    // for CGB mode if background window is not enabled, obj always gets priority.
+    obj_drawn = true;
   } else {
-    switch (color_idx) {
-      case 0:
-        state.pixels[pixel] = kGreyPalette[state.registers.bgp_id0];
-        break;
-      case 1:
-        state.pixels[pixel] = kGreyPalette[state.registers.bgp_id1];
-        break;
-      case 2:
-        state.pixels[pixel] = kGreyPalette[state.registers.bgp_id2];
-        break;
-      case 3:
-        state.pixels[pixel] = kGreyPalette[state.registers.bgp_id3];
-        break;
-      default:
-        assert(false);
-    }
+    obj_drawn = color_idx == 0 || !(obj_attrs.priority || bg_attrs.priority);
   }
+
+  if (!obj_drawn) {
+    return bg_attrs.cgb_palette * 4 + color_idx;
+  }
+  int palette = registers.cgb_mode ? obj_attrs.cgb_palette : obj_attrs.dmg_palette;
+  return kObjPaletteEntries + palette * 4 + obj_color_idx;
 }
 
-void PushObjPixel(int pixel, int color_idx, const PpuState &state) {
-  if (state.registers.cgb_mode) {
-    PushObjColorPixel(pixel, color_idx,
-                      GetColorPalette(state, state.registers.obj_attrs), state.pixels);
+// Mix a pixel with the attributes currently in bg_attrs and obj_attrs.
+void MixPixel(const PpuState &state, int pixel, int color_idx, int obj_color_idx) {
+  const Registers &registers = state.registers;
+  int entry = MixEntry(registers, color_idx, registers.bg_attrs, obj_color_idx, registers.obj_attrs);
+  if (state.indexed) {
+    state.indexed->entries[pixel] = entry;
   } else {
-    Palette palette{};
-    if (state.registers.obj_attrs.dmg_palette) {
-      palette.val = state.registers.OBP1;
-    } else {
-      palette.val = state.registers.OBP0;
-    }
-    switch (color_idx) {
-      case 0:
-        state.pixels[pixel] = kGreyPalette[palette.color0];
-        break;
-      case 1:
-        state.pixels[pixel] = kGreyPalette[palette.color1];
-        break;
-      case 2:
-        state.pixels[pixel] = kGreyPalette[palette.color2];
-        break;
-      case 3:
-        state.pixels[pixel] = kGreyPalette[palette.color3];
-        break;
-      default:
-        assert(false);
-    }
+    state.pixels[pixel] = registers.palette_rgb[entry];
   }
 }
 
+void SnapshotLinePalette(const PpuState &state, int line) {
+  SetLinePalette(state.indexed, line, state.registers.palette_rgb);
+}
+
 void PushPixel(const PpuState &state) {
-  int bg_step = state.registers.bg_step;
-  uint8_t bg_mask = 0x80 >> bg_step;
-  if (state.registers.bg_attrs.flip_x) {
-    bg_mask = 0x1 << bg_step;
+  int color_idx = state.registers.bg_row[state.registers.bg_step];
+  int x = state.registers.x_pos;
+  state.registers.obj_attrs = state.obj_line->attrs[x];
+  MixPixel(state, x + state.registers.LY * 160, color_idx, state.obj_line->color[x]);
+  if (state.indexed && x == 159) {
+    SnapshotLinePalette(state, state.registers.LY);
   }
-  int color_idx = 0;
-  if (bg_mask & state.registers.bg_low) color_idx++;
-  if (bg_mask & state.registers.bg_high) color_idx += 2;
+}
 
-  if (!state.registers.cgb_mode && !state.registers.bgw_ef) {
-    color_idx = 0;
+// Decoded BG or window tile row at pixel (x, y) of the tile map at map_offset.
+const uint8_t *FetchMapTileRow(const PpuState &state, int map_offset, int x, int y, BgWindowAttributes &attrs) {
+  int x_tile = x / 8;
+  int y_tile = y / 8;
+  int map_idx = map_offset + x_tile + y_tile * 32;
+  attrs.attr = state.registers.cgb_mode ? state.vram_bank1[map_idx] : 0;
+  int tile_addr = GetTileAddr(state, state.vram[map_idx]);
+  int tile_row = y % 8;
+  if (attrs.flip_y) {
+    tile_row = 7 - tile_row;
   }
+  return DecodedTileRow(state, attrs.bank, tile_addr + tile_row * 2, attrs.flip_x);
+}
 
-  int obj_color_idx = GetObjColor(state);
-
-  if (!state.registers.obj_ef) {
-    obj_color_idx = 0;
+// Copy the BG or window pixels of [x, end) into the line buffers, one tile
+// row at a time. map_x is the tile map column of pixel x.
+void CopyMapRuns(const PpuState &state, int map_offset, int x, int end, int map_x, int map_y,
+                 uint8_t *bg_color, BgWindowAttributes *bg_attrs) {
+  BgWindowAttributes attrs{};
+  while (x < end) {
+    map_x %= 256;
+    int step = map_x % 8;
+    int run = std::min(8 - step, end - x);
+    const uint8_t *row = FetchMapTileRow(state, map_offset, map_x, map_y, attrs);
+    memcpy(bg_color + x, row + step, run);
+    std::fill_n(bg_attrs + x, run, attrs);
+    x += run;
+    map_x += run;
   }
+}
 
-  int pixel = state.registers.x_pos + state.registers.LY * 160;
-  if (obj_color_idx == 0) {
-    PushBgPixel(pixel, color_idx, state);
-  } else if (state.registers.cgb_mode && !state.registers.bgw_ef) {
-    // for CGB mode if background window is not enabled, obj always gets priority.
-    PushObjPixel(pixel, obj_color_idx, state);
-  } else if (color_idx > 0 && (state.registers.obj_attrs.priority || state.registers.bg_attrs.priority)) {
-    PushBgPixel(pixel, color_idx, state);
-  } else {
-    PushObjPixel(pixel, obj_color_idx, state);
+// First pixel of the window on the current line, or 160 if it is not shown.
+// Follows the same WX/WY latching as the dot renderer.
+int WindowStart(const PpuState &state) {
+  Registers &registers = state.registers;
+  int window_start = 160;
+  if (registers.window_enable && registers.wy_eq && registers.LY >= registers.WY) {
+    if (registers.wx_eq) {
+      window_start = registers.WX < 7 ? 0 : registers.WX - 7;
+    } else if (registers.WX < 160) {
+      window_start = registers.WX;
+    }
   }
-
+  if (registers.WX < 160) {
+    registers.wx_eq = true;
+  }
+  return window_start;
 }
 
 }  // namespace
@@ -388,17 +259,11 @@ void PushPixel(const PpuState &state) {
 void DrawTile(const PpuState &state, int tileAddr, int x, int y, uint32_t *pixels) {
   for (int row = 0; row < 8; ++row) {
     if (RowOutOfBounds(row + y)) continue;
-    uint8_t left_byte = state.vram[tileAddr + row * 2];
-    uint8_t right_byte = state.vram[tileAddr + row * 2 + 1];
-    uint8_t mask = 0x80;
-    int shift = 7;
+    const uint8_t *decoded = DecodedTileRow(state, 0, tileAddr + row * 2, false);
     for (int col = 0; col < 8; ++col) {
       if (ColOutOfBounds(col + x)) continue;
       int pixel = ((y + row) * 160) + x + col;
-      int val = 0; // ((left_byte & mask)| ((right_byte & mask) >> (shift-1));
-      if (left_byte & mask) val += 1;
-      if (right_byte & mask) val += 2;
-      switch (val) {
+      switch (decoded[col]) {
         case 0:
           pixels[pixel] = kGreyPalette[state.registers.bgp_id0];
           break;
@@ -414,8 +279,6 @@ void DrawTile(const PpuState &state, int tileAddr, int x, int y, uint32_t *pixel
         default:
           assert(false);
       }
-      --shift;
-      mask >>= 1;
     }
   }
 }
@@ -522,49 +385,186 @@ void DrawOam(const PpuState &state) {
   }
 }
 
-void DrawDebugTile(const PpuState &state, int tileAddr, int x, int y, uint32_t *pixels, uint8_t *bank) {
-  for (int row = 0; row < 8; ++row) {
-    uint8_t left_byte = state.vram[tileAddr + row * 2];
-    uint8_t right_byte = state.vram[tileAddr + row * 2 + 1];
-    uint8_t mask = 0x80;
-    int shift = 7;
-    for (int col = 0; col < 8; ++col) {
-      int pixel = ((y + row) * 256) + x + col;
-      int val = 0;
-      if (left_byte & mask) val += 1;
-      if (right_byte & mask) val += 2;
-      switch (val) {
-        case 0:
-          pixels[pixel] = kGreyPalette[state.registers.bgp_id0];
-          break;
-        case 1:
-          pixels[pixel] = kGreyPalette[state.registers.bgp_id1];
-          break;
-        case 2:
-          pixels[pixel] = kGreyPalette[state.registers.bgp_id2];
-          break;
-        case 3:
-          pixels[pixel] = kGreyPalette[state.registers.bgp_id3];
-          break;
-        default:
-          assert(false);
+void ScanOam(const PpuState &state) {
+  const Registers &registers = state.registers;
+  int height = registers.obj_sz ? 16 : 8;
+  int oam_idx[10];
+  int count = 0;
+  for (int i = 0; i < 0xA0 && count < 10; i += 4) {
+    int row = state.oam[i] - 16;
+    if (registers.LY >= row && registers.LY < row + height) {
+      oam_idx[count++] = i;
+    }
+  }
+  if (!registers.cgb_mode) {
+    // On DMG the OBJ with the smaller X is drawn on top, OAM order breaks
+    // ties. The sort has to be stable to keep that order.
+    for (int i = 1; i < count; ++i) {
+      int idx = oam_idx[i];
+      int j = i - 1;
+      for (; j >= 0 && state.oam[oam_idx[j] + 1] > state.oam[idx + 1]; --j) {
+        oam_idx[j + 1] = oam_idx[j];
+      }
+      oam_idx[j + 1] = idx;
+    }
+  }
+  memset(state.oam_buffer, 0, 0x28);
+  for (int i = 0; i < count; ++i) {
+    memcpy(state.oam_buffer + i * 4, state.oam + oam_idx[i], 4);
+  }
+}
+
+void BuildObjLine(const PpuState &state) {
+  ObjLine &obj_line = *state.obj_line;
+  memset(obj_line.color, 0, sizeof(obj_line.color));
+  for (int i = 0; i < 0x28 && state.oam_buffer[i] != 0; i += 4) {
+    int row = state.oam_buffer[i] - 16;
+    int col = state.oam_buffer[i + 1] - 8;
+    SpriteAttributes attributes{.attr = state.oam_buffer[i + 3]};
+    int tile_row = state.registers.LY - row;
+    if (attributes.flip_y) {
+      tile_row = ObjSz(state) - tile_row;
+    }
+    int sprite_addr = GetSpriteAddr(state, state.oam_buffer[i + 2]);
+    const uint8_t *decoded = DecodedTileRow(state, attributes.bank, sprite_addr + tile_row * 2, attributes.flip_x);
+    for (int step = 0; step < 8; ++step) {
+      int x = col + step;
+      // a higher priority OBJ only hides the ones below where it is opaque.
+      if (ColOutOfBounds(x) || obj_line.color[x] != 0) {
+        continue;
+      }
+      obj_line.color[x] = decoded[step];
+      obj_line.attrs[x] = attributes;
+    }
+  }
+}
+
+void DrawScanline(const PpuState &state) {
+  Registers &registers = state.registers;
+  int line = registers.LY;
+  if (line > 143) {
+    return;
+  }
+  uint8_t bg_color[160];
+  BgWindowAttributes bg_attrs[160];
+
+  // Background and window, copied from the tile cache a tile row at a time.
+  int window_start = WindowStart(state);
+  CopyMapRuns(state, GetBgOffset(registers), 0, window_start, registers.SCX,
+              (registers.SCY + line) % 256, bg_color, bg_attrs);
+  CopyMapRuns(state, GetWindowOffset(registers), window_start, 160, window_start + 7 - registers.WX,
+              registers.WLY, bg_color, bg_attrs);
+  if (window_start < 160) {
+    registers.is_in_window = true;
+  }
+
+  BuildObjLine(state);
+  const ObjLine &obj_line = *state.obj_line;
+  uint8_t line_entries[160];
+  uint8_t *entries = state.indexed ? state.indexed->entries + line * 160 : line_entries;
+  for (int x = 0; x < 160; ++x) {
+    entries[x] = MixEntry(registers, bg_color[x], bg_attrs[x], obj_line.color[x], obj_line.attrs[x]);
+  }
+  if (state.indexed) {
+    SnapshotLinePalette(state, line);
+    return;
+  }
+  Kernels().gather_colors(entries, registers.palette_rgb, 160, state.pixels + line * 160);
+}
+
+void DrawSpan(const PpuState &state, int end) {
+  Registers &registers = state.registers;
+  int line = registers.LY;
+  end = std::min(end, Memory::kScreenWidth);
+  if (line > 143 || registers.x_pos >= end) {
+    return;
+  }
+  const ObjLine &obj_line = *state.obj_line;
+  uint8_t line_entries[160];
+  uint8_t *entries = state.indexed ? state.indexed->entries + line * 160 : line_entries;
+  int first = registers.x_pos;
+  while (registers.x_pos < end) {
+    int x = registers.x_pos;
+    if (x == registers.WX) {
+      registers.wx_eq = true;
+    }
+    if (!registers.is_in_window && IsInWindow(state)) {
+      registers.is_in_window = true;
+      SetWindowTileRow(state);
+    } else if (registers.bg_step == 0) {
+      if (registers.is_in_window) {
+        SetWindowTileRow(state);
+      } else {
+        SetBgTileRow(state);
       }
-      --shift;
-      mask >>= 1;
     }
+    // the rest of the tile row, stopping where the window could start.
+    int run = std::min(8 - registers.bg_step, end - x);
+    if (!registers.is_in_window) {
+      for (int window_x : {static_cast<int>(registers.WX), registers.WX - 7}) {
+        if (window_x > x) {
+          run = std::min(run, window_x - x);
+        }
+      }
+    }
+    const uint8_t *colors = registers.bg_row + registers.bg_step;
+    for (int i = 0; i < run; ++i) {
+      entries[x + i] = MixEntry(registers, colors[i], registers.bg_attrs, obj_line.color[x + i],
+                                obj_line.attrs[x + i]);
+    }
+    registers.bg_step = (registers.bg_step + run) % 8;
+    registers.x_pos += run;
+  }
+  if (state.indexed) {
+    if (end == 160) {
+      SnapshotLinePalette(state, line);
+    }
+  } else {
+    Kernels().gather_colors(entries + first, registers.palette_rgb, end - first,
+                            state.pixels + line * 160 + first);
   }
+  if (end == 160) {
+    // the fetcher starts the next line on a fresh tile, as DrawDot leaves it.
+    registers.bg_step = 0;
+  }
+}
+
+void SetFrameObserver(FrameObserver observer) {
+  frame_observer = observer;
 }
 
-void DrawDebugScreen(const PpuState &state) {
-  auto *pixels = new uint32_t[256 * 512];
-  for (int row = 0; row < 64; ++row) {
-    for (int col = 0; col < 32; ++col) {
-      uint8_t tile_idx = state.vram[0x1800 + (row * 32) + col];
-      int vram_location = GetTileAddr(state, tile_idx);
-      DrawDebugTile(state, vram_location, col * 8, row * 8, pixels, 0);
+void PublishDrawnFrame(const PpuState &state, uint64_t clock) {
+  bool capturing = Capture::IsCapturing();
+  if (state.indexed) {
+    GUI::PublishIndexedFrame(*state.indexed);
+    if (capturing) {
+      Capture::SubmitIndexedFrame(*state.indexed, clock);
+    }
+    if (frame_observer) {
+      static uint32_t expanded[Memory::kScreenWidth * Memory::kScreenHeight];
+      ExpandIndexedFrame(*state.indexed, expanded, Memory::kScreenWidth);
+      frame_observer(expanded);
+    }
+  } else {
+    GUI::PublishFrame(state.pixels);
+    if (capturing) {
+      Capture::SubmitFrame(state.pixels, clock);
     }
+    if (frame_observer) {
+      frame_observer(state.pixels);
+    }
+  }
+}
+
+void ClearFrame(const PpuState &state) {
+  if (state.indexed) {
+    memset(state.indexed->entries, 0, sizeof(state.indexed->entries));
+    memset(state.indexed->line_palettes, 0, sizeof(state.indexed->line_palettes));
+    state.indexed->palette_count = 1;
+    std::fill_n(state.indexed->palettes[0], kPaletteEntries, kWhite);
+  } else {
+    std::fill_n(state.pixels, Memory::kScreenWidth * Memory::kScreenHeight, kWhite);
   }
-  GUI::DrawDebugScreen(pixels);
 }
 
 void DrawDot(const PpuState &state) {
@@ -572,7 +572,6 @@ void DrawDot(const PpuState &state) {
   int x_pos = state.registers.x_pos;
   if (x_pos >= 160) {
     state.registers.bg_step = 0;
-    state.registers.obj_step = 0;
     return;
   }
   // in order for window to turn on in a frame at one point WX must be
@@ -582,20 +581,17 @@ void DrawDot(const PpuState &state) {
   }
   if (!state.registers.is_in_window && IsInWindow(state)) {
     state.registers.is_in_window = true;
-    SetWindowTileLowHigh(state);
+    SetWindowTileRow(state);
   } else if (bg_step == 0) {
     if (state.registers.is_in_window) {
-      SetWindowTileLowHigh(state);
+      SetWindowTileRow(state);
     } else {
-      SetBgTileLowHigh(state);
+      SetBgTileRow(state);
     }
   }
-  SetObjTileLowHigh(state);
   PushPixel(state);
   ++state.registers.bg_step;
-  ++state.registers.obj_step;
   state.registers.bg_step %= 8;
-  state.registers.obj_step %= 8;
   ++state.registers.x_pos;
 }
 
@@ -18,12 +18,38 @@ void DrawBackground(const PpuState& state, uint32_t* pixels);
 
 void DrawWindow(const PpuState& state, uint32_t* pixels);
 
-void DrawDebugScreen(const PpuState& state);
-
 void DrawOam(const PpuState& state);
 
+// Select the up to 10 OBJs on the current line into the OAM buffer, sorted
+// from the highest drawing priority to the lowest.
+void ScanOam(const PpuState& state);
+
+// Fetch the tile row of every OBJ in the OAM buffer once and lay the line out
+// in state.obj_line for the pixel pipeline to index.
+void BuildObjLine(const PpuState& state);
+
 void DrawDot(const PpuState& state);
 
+// Compose the whole current line at once with the registers as they are now.
+void DrawScanline(const PpuState& state);
+
+// Draw the current line from registers.x_pos up to pixel end, a tile row at a
+// time, with the registers as they are now. Fetches and starts the window at
+// the same pixels DrawDot would, so a line drawn in spans split at register
+// writes comes out the same as drawn dot by dot.
+void DrawSpan(const PpuState& state, int end);
+
+// Called with every finished frame as RGB888, from the thread that drew it.
+using FrameObserver = void (*)(const uint32_t* pixels);
+void SetFrameObserver(FrameObserver observer);
+
+// Hand the frame finished at CPU clock to the GUI, and the capture and frame
+// observer if there are any, in the format state draws in.
+void PublishDrawnFrame(const PpuState& state, uint64_t clock);
+
+// Blank the frame to white, as the LCD shows while it is off.
+void ClearFrame(const PpuState& state);
+
 }
 
 #endif //GB_EMU_SRC_RENDERING_DRAW_H_
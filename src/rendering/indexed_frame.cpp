@@ -0,0 +1,40 @@
+//
+// Created by Brian Bonafilia on 12/31/24.
+//
+
+#include "indexed_frame.h"
+
+#include <cstring>
+#include "pixel_kernels.h"
+
+namespace PPU {
+
+void SetLinePalette(IndexedFrame *frame, int line, const uint32_t *palette) {
+  if (line == 0) {
+    frame->palette_count = 0;
+  }
+  int last = frame->palette_count - 1;
+  constexpr size_t kSize = sizeof(frame->palettes[0]);
+  if (last < 0 || memcmp(frame->palettes[last], palette, kSize) != 0) {
+    memcpy(frame->palettes[++last], palette, kSize);
+    frame->palette_count = last + 1;
+  }
+  frame->line_palettes[line] = last;
+}
+
+void CopyIndexedFrame(const IndexedFrame &from, IndexedFrame *to) {
+  memcpy(to->entries, from.entries, sizeof(from.entries));
+  memcpy(to->line_palettes, from.line_palettes, sizeof(from.line_palettes));
+  to->palette_count = from.palette_count;
+  memcpy(to->palettes, from.palettes, from.palette_count * sizeof(from.palettes[0]));
+}
+
+void ExpandIndexedFrame(const IndexedFrame &frame, uint32_t *pixels, int stride) {
+  const PixelKernels &kernels = Kernels();
+  for (int line = 0; line < Memory::kScreenHeight; ++line) {
+    kernels.gather_colors(frame.entries + line * Memory::kScreenWidth, frame.palettes[frame.line_palettes[line]], Memory::kScreenWidth,
+                          pixels + line * stride);
+  }
+}
+
+}  // namespace PPU
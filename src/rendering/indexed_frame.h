@@ -0,0 +1,44 @@
+//
+// Created by Brian Bonafilia on 12/31/24.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_INDEXED_FRAME_H_
+#define GB_EMU_SRC_RENDERING_INDEXED_FRAME_H_
+
+#include <cstdint>
+#include "../memory_arena.h"
+#include "../ppu.h"
+
+namespace PPU {
+
+// A frame as one palette table entry per pixel, with the palette tables the
+// lines were drawn with. A line only adds a table when the palette changed
+// since the line before, so a frame without palette writes copies 23KB with
+// CopyIndexedFrame, a quarter of the RGB frame, for anything that only needs
+// the shade or palette index. It is expanded to host pixels only when
+// something has to show it.
+//
+// A line's palette is the table as it was when the line finished drawing, so
+// palette writes in the middle of a line apply to all of it, like in the
+// scanline renderer.
+struct IndexedFrame {
+  uint8_t entries[Memory::kScreenWidth * Memory::kScreenHeight];
+  // index into palettes of the table each line was drawn with.
+  uint8_t line_palettes[Memory::kScreenHeight];
+  int palette_count;
+  uint32_t palettes[Memory::kScreenHeight][kPaletteEntries];
+};
+
+// Record the palette table line finished drawing with, line 0 starts a new
+// list of tables.
+void SetLinePalette(IndexedFrame* frame, int line, const uint32_t* palette);
+
+// Copy a frame without the unused palette tables.
+void CopyIndexedFrame(const IndexedFrame& from, IndexedFrame* to);
+
+// Look every pixel up in its line's palette, stride is in pixels.
+void ExpandIndexedFrame(const IndexedFrame& frame, uint32_t* pixels, int stride);
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_RENDERING_INDEXED_FRAME_H_
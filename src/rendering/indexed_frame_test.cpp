@@ -0,0 +1,47 @@
+//
+// Created by Brian Bonafilia on 1/9/25.
+//
+
+#include "indexed_frame.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace PPU {
+namespace {
+
+constexpr int kPixels = Memory::kScreenWidth * Memory::kScreenHeight;
+
+TEST(IndexedFrame, KeepsOnlyChangedPalettes) {
+  auto frame = std::make_unique<IndexedFrame>();
+  uint32_t palette[kPaletteEntries]{};
+  for (int line = 0; line < Memory::kScreenHeight; ++line) {
+    // the palette changes once, at line 100.
+    palette[1] = line < 100 ? 0x111111 : 0x222222;
+    SetLinePalette(frame.get(), line, palette);
+    std::fill_n(frame->entries + line * Memory::kScreenWidth, Memory::kScreenWidth, 1);
+  }
+  EXPECT_EQ(frame->palette_count, 2);
+
+  // a new frame starts the list over.
+  SetLinePalette(frame.get(), 0, palette);
+  EXPECT_EQ(frame->palette_count, 1);
+  palette[1] = 0x111111;
+  for (int line = 1; line < 100; ++line) {
+    SetLinePalette(frame.get(), line, palette);
+  }
+  EXPECT_EQ(frame->palette_count, 2);
+
+  auto copy = std::make_unique<IndexedFrame>();
+  CopyIndexedFrame(*frame, copy.get());
+  std::vector<uint32_t> pixels(kPixels);
+  ExpandIndexedFrame(*copy, pixels.data(), Memory::kScreenWidth);
+  EXPECT_EQ(pixels[0], 0x222222u);
+  EXPECT_EQ(pixels[50 * Memory::kScreenWidth], 0x111111u);
+  EXPECT_EQ(pixels[99 * Memory::kScreenWidth + 159], 0x111111u);
+}
+
+}  // namespace
+}  // namespace PPU
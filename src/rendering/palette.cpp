@@ -0,0 +1,56 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#include "palette.h"
+
+#include <algorithm>
+
+namespace PPU {
+
+namespace {
+
+uint32_t ConvertColor(Color c, ColorProfile profile) {
+  if (profile == lcd_colors) {
+    uint32_t red = std::min(960u, c.red() * 26 + c.green() * 4 + c.blue() * 2) >> 2;
+    uint32_t green = std::min(960u, c.green() * 24 + c.blue() * 8) >> 2;
+    uint32_t blue = std::min(960u, c.red() * 6 + c.green() * 4 + c.blue() * 22) >> 2;
+    return (red << 16) | (green << 8) | blue;
+  }
+  return ToRgb888(c);
+}
+
+uint32_t PaletteEntryColor(const Registers &registers, ColorProfile profile, int entry) {
+  if (registers.cgb_mode) {
+    const uint8_t *cram = entry < kObjPaletteEntries ? registers.bg_cram : registers.obj_cram;
+    int offset = (entry % kObjPaletteEntries) * 2;
+    return ConvertColor(Color{static_cast<uint16_t>(cram[offset] | (cram[offset + 1] << 8))}, profile);
+  }
+  uint8_t palette = registers.BGP;
+  if (entry >= kObjPaletteEntries) {
+    palette = (entry & 4) ? registers.OBP1 : registers.OBP0;
+  }
+  return kGreyPalette[(palette >> ((entry & 3) * 2)) & 3];
+}
+
+}  // namespace
+
+void UpdatePaletteEntries(Registers &registers, ColorProfile profile, int first, int count) {
+  for (int entry = first; entry < first + count; ++entry) {
+    registers.palette_rgb[entry] = PaletteEntryColor(registers, profile, entry);
+  }
+}
+
+void UpdateDmgPalette(Registers &registers, ColorProfile profile, int first) {
+  if (!registers.cgb_mode) {
+    UpdatePaletteEntries(registers, profile, first, 4);
+  }
+}
+
+void UpdateCgbPaletteColor(Registers &registers, ColorProfile profile, int first, uint8_t color_addr) {
+  if (registers.cgb_mode) {
+    UpdatePaletteEntries(registers, profile, first + color_addr / 2, 1);
+  }
+}
+
+}  // namespace PPU
@@ -0,0 +1,26 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_PALETTE_H_
+#define GB_EMU_SRC_RENDERING_PALETTE_H_
+
+#include <cstdint>
+#include "../ppu.h"
+
+namespace PPU {
+
+// Refresh count entries of registers.palette_rgb starting at first.
+void UpdatePaletteEntries(Registers& registers, ColorProfile profile, int first, int count);
+
+// Refresh the 4 entries from first after a BGP, OBP0 or OBP1 write. They only
+// feed the table outside of CGB mode.
+void UpdateDmgPalette(Registers& registers, ColorProfile profile, int first);
+
+// Refresh the color a CRAM write at color_addr changed, first being 0 for BG
+// CRAM and kObjPaletteEntries for OBJ CRAM. CRAM only feeds the table in CGB mode.
+void UpdateCgbPaletteColor(Registers& registers, ColorProfile profile, int first, uint8_t color_addr);
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_RENDERING_PALETTE_H_
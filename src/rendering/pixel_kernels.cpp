@@ -0,0 +1,133 @@
+//
+// Created by Brian Bonafilia on 12/22/24.
+//
+
+#include "pixel_kernels.h"
+
+#include "simd.h"
+
+namespace PPU {
+
+namespace {
+
+// Bit of each output pixel in a bitplane byte, leftmost pixel first.
+constexpr uint64_t kPixelBits = 0x0102040810204080;
+constexpr uint64_t kFlippedPixelBits = 0x8040201008040201;
+// Multiplying a byte by this repeats it in all 8 bytes of a uint64_t.
+constexpr uint64_t kBroadcastByte = 0x0101010101010101;
+
+void DecodeRowsScalar(const uint8_t *planes, int count, bool flip_x, uint8_t *out) {
+  for (int row = 0; row < count; ++row) {
+    uint8_t low = planes[row * 2];
+    uint8_t high = planes[row * 2 + 1];
+    for (int col = 0; col < 8; ++col) {
+      int shift = flip_x ? col : 7 - col;
+      out[row * 8 + col] = ((low >> shift) & 1) | (((high >> shift) & 1) << 1);
+    }
+  }
+}
+
+void GatherColorsScalar(const uint8_t *indices, const uint32_t *palette, int count, uint32_t *out) {
+  for (int i = 0; i < count; ++i) {
+    out[i] = palette[indices[i]];
+  }
+}
+
+#ifdef GB_EMU_X86_KERNELS
+
+// Two rows per vector: every byte tests its pixel's bit in a copy of the
+// bitplane byte, giving 0 or 1 (low) and 0 or 2 (high) per pixel.
+void DecodeRowsSse2(const uint8_t *planes, int count, bool flip_x, uint8_t *out) {
+  uint64_t bits = flip_x ? kFlippedPixelBits : kPixelBits;
+  const __m128i mask = _mm_set1_epi64x(bits);
+  const __m128i one = _mm_set1_epi8(1);
+  int row = 0;
+  for (; row + 2 <= count; row += 2) {
+    __m128i low = _mm_set_epi64x(planes[row * 2 + 2] * kBroadcastByte, planes[row * 2] * kBroadcastByte);
+    __m128i high = _mm_set_epi64x(planes[row * 2 + 3] * kBroadcastByte, planes[row * 2 + 1] * kBroadcastByte);
+    low = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, mask), mask), one);
+    high = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, mask), mask), one);
+    __m128i color = _mm_or_si128(low, _mm_add_epi8(high, high));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + row * 8), color);
+  }
+  DecodeRowsScalar(planes + row * 2, count - row, flip_x, out + row * 8);
+}
+
+// Same as the SSE2 version with four rows per vector.
+__attribute__((target("avx2")))
+void DecodeRowsAvx2(const uint8_t *planes, int count, bool flip_x, uint8_t *out) {
+  uint64_t bits = flip_x ? kFlippedPixelBits : kPixelBits;
+  const __m256i mask = _mm256_set1_epi64x(bits);
+  const __m256i one = _mm256_set1_epi8(1);
+  int row = 0;
+  for (; row + 4 <= count; row += 4) {
+    const uint8_t *p = planes + row * 2;
+    __m256i low = _mm256_set_epi64x(p[6] * kBroadcastByte, p[4] * kBroadcastByte,
+                                    p[2] * kBroadcastByte, p[0] * kBroadcastByte);
+    __m256i high = _mm256_set_epi64x(p[7] * kBroadcastByte, p[5] * kBroadcastByte,
+                                     p[3] * kBroadcastByte, p[1] * kBroadcastByte);
+    low = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(low, mask), mask), one);
+    high = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(high, mask), mask), one);
+    __m256i color = _mm256_or_si256(low, _mm256_add_epi8(high, high));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + row * 8), color);
+  }
+  DecodeRowsSse2(planes + row * 2, count - row, flip_x, out + row * 8);
+}
+
+// Eight pixels per iteration with a hardware gather from the palette.
+__attribute__((target("avx2")))
+void GatherColorsAvx2(const uint8_t *indices, const uint32_t *palette, int count, uint32_t *out) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(indices + i));
+    __m256i idx = _mm256_cvtepu8_epi32(packed);
+    __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), idx, 4);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), colors);
+  }
+  GatherColorsScalar(indices + i, palette, count - i, out + i);
+}
+
+#endif
+
+constexpr PixelKernels kScalarKernels{DecodeRowsScalar, GatherColorsScalar};
+#ifdef GB_EMU_X86_KERNELS
+// SSE2 has no gather, the scalar loop is as fast as emulating one.
+constexpr PixelKernels kSse2Kernels{DecodeRowsSse2, GatherColorsScalar};
+constexpr PixelKernels kAvx2Kernels{DecodeRowsAvx2, GatherColorsAvx2};
+#endif
+
+}  // namespace
+
+SimdLevel DetectSimdLevel() {
+#ifdef GB_EMU_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2_kernels;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return sse2_kernels;
+  }
+#endif
+  return scalar_kernels;
+}
+
+const PixelKernels &KernelsFor(SimdLevel level) {
+#ifdef GB_EMU_X86_KERNELS
+  switch (level) {
+    case avx2_kernels:
+      return kAvx2Kernels;
+    case sse2_kernels:
+      return kSse2Kernels;
+    case scalar_kernels:
+      break;
+  }
+#endif
+  return kScalarKernels;
+}
+
+const PixelKernels &Kernels() {
+  static const PixelKernels &kernels = KernelsFor(DetectSimdLevel());
+  return kernels;
+}
+
+}  // namespace PPU
@@ -0,0 +1,37 @@
+//
+// Created by Brian Bonafilia on 12/22/24.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_PIXEL_KERNELS_H_
+#define GB_EMU_SRC_RENDERING_PIXEL_KERNELS_H_
+
+#include <cstdint>
+
+namespace PPU {
+
+enum SimdLevel {
+  scalar_kernels,
+  sse2_kernels,
+  avx2_kernels
+};
+
+struct PixelKernels {
+  // Decode count rows of 2bpp tile data, a low and a high bitplane byte per
+  // row, into 8 color indices per row. flip_x mirrors every row.
+  void (*decode_rows)(const uint8_t* planes, int count, bool flip_x, uint8_t* out);
+  // out[i] = palette[indices[i]] for count pixels.
+  void (*gather_colors)(const uint8_t* indices, const uint32_t* palette, int count, uint32_t* out);
+};
+
+// Best level the CPU we are running on supports.
+SimdLevel DetectSimdLevel();
+
+// Kernels of a level, falling back to the next lower level the build has.
+const PixelKernels& KernelsFor(SimdLevel level);
+
+// Kernels of the detected level, picked on first use.
+const PixelKernels& Kernels();
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_RENDERING_PIXEL_KERNELS_H_
@@ -0,0 +1,93 @@
+//
+// Created by Brian Bonafilia on 12/22/24.
+//
+
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace PPU {
+namespace {
+
+constexpr SimdLevel kLevels[]{scalar_kernels, sse2_kernels, avx2_kernels};
+
+// Every possible pair of bitplane bytes, 0x10000 rows.
+std::vector<uint8_t> AllPlanes() {
+  std::vector<uint8_t> planes;
+  for (int low = 0; low < 0x100; ++low) {
+    for (int high = 0; high < 0x100; ++high) {
+      planes.push_back(low);
+      planes.push_back(high);
+    }
+  }
+  return planes;
+}
+
+TEST(PixelKernels, DecodeRowsScalar) {
+  // low 0b10100000, high 0b11000000
+  uint8_t planes[]{0xA0, 0xC0};
+  uint8_t out[8];
+  KernelsFor(scalar_kernels).decode_rows(planes, 1, false, out);
+  EXPECT_EQ(out[0], 3);
+  EXPECT_EQ(out[1], 2);
+  EXPECT_EQ(out[2], 1);
+  EXPECT_EQ(out[3], 0);
+  EXPECT_EQ(out[7], 0);
+
+  KernelsFor(scalar_kernels).decode_rows(planes, 1, true, out);
+  EXPECT_EQ(out[7], 3);
+  EXPECT_EQ(out[6], 2);
+  EXPECT_EQ(out[5], 1);
+  EXPECT_EQ(out[0], 0);
+}
+
+TEST(PixelKernels, DecodeRowsMatchScalar) {
+  if (DetectSimdLevel() == scalar_kernels) {
+    GTEST_SKIP() << "no SIMD kernels on this CPU";
+  }
+  std::vector<uint8_t> planes = AllPlanes();
+  int rows = planes.size() / 2;
+  std::vector<uint8_t> expected(rows * 8);
+  std::vector<uint8_t> actual(rows * 8);
+  for (bool flip_x : {false, true}) {
+    KernelsFor(scalar_kernels).decode_rows(planes.data(), rows, flip_x, expected.data());
+    for (SimdLevel level : kLevels) {
+      if (level > DetectSimdLevel()) continue;
+      // odd row counts exercise the scalar tails.
+      for (int count : {rows, rows - 1, 3, 1}) {
+        std::fill(actual.begin(), actual.end(), 0xFF);
+        KernelsFor(level).decode_rows(planes.data(), count, flip_x, actual.data());
+        EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + count * 8, actual.begin()))
+            << "level " << level << " count " << count << " flip " << flip_x;
+        if (count < rows) {
+          EXPECT_EQ(actual[count * 8], 0xFF) << "wrote past row " << count;
+        }
+      }
+    }
+  }
+}
+
+TEST(PixelKernels, GatherColorsMatchScalar) {
+  uint32_t palette[64];
+  for (int i = 0; i < 64; ++i) {
+    palette[i] = 0x010203 * (i + 1);
+  }
+  uint8_t indices[163];
+  for (int i = 0; i < 163; ++i) {
+    indices[i] = (i * 37) % 64;
+  }
+  uint32_t expected[163];
+  KernelsFor(scalar_kernels).gather_colors(indices, palette, 163, expected);
+  EXPECT_EQ(expected[1], palette[37]);
+  for (SimdLevel level : kLevels) {
+    if (level > DetectSimdLevel()) continue;
+    uint32_t actual[163]{};
+    KernelsFor(level).gather_colors(indices, palette, 163, actual);
+    EXPECT_TRUE(std::equal(expected, expected + 163, actual)) << "level " << level;
+  }
+}
+
+}
+}
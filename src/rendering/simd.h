@@ -0,0 +1,18 @@
+//
+// Created by Brian Bonafilia on 1/8/25.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_SIMD_H_
+#define GB_EMU_SRC_RENDERING_SIMD_H_
+
+// Whether this build has the x86 kernels of the SimdLevels in
+// pixel_kernels.h. Only on x86-64, where SSE2 is always there and needs no
+// target attribute; 32 bit x86 and everything else use the scalar kernels.
+// The AVX2 kernels are compiled with __attribute__((target("avx2"))) and
+// only picked when DetectSimdLevel finds the CPU supports them.
+#if defined(__x86_64__)
+#define GB_EMU_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#endif //GB_EMU_SRC_RENDERING_SIMD_H_
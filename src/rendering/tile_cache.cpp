@@ -0,0 +1,53 @@
+//
+// Created by Brian Bonafilia on 12/20/24.
+//
+
+#include "tile_cache.h"
+
+#include <cstring>
+#include "pixel_kernels.h"
+#include "../ppu.h"
+
+namespace PPU {
+
+namespace {
+
+void DecodeTile(const PpuState &state, int bank, int tile) {
+  const uint8_t *data = (bank ? state.vram_bank1 : state.vram) + tile * 16;
+  auto &decoded = state.tile_cache->pixels[bank][tile];
+  Kernels().decode_rows(data, 8, false, decoded[0][0]);
+  Kernels().decode_rows(data, 8, true, decoded[1][0]);
+}
+
+}  // namespace
+
+void MarkTilesDirty(TileCache &cache, int bank, int addr, int length) {
+  int last = addr + length - 1;
+  if (addr >= kTilesPerBank * 16 || length <= 0) {
+    return;
+  }
+  if (last >= kTilesPerBank * 16) {
+    last = kTilesPerBank * 16 - 1;
+  }
+  for (int tile = addr / 16; tile <= last / 16; ++tile) {
+    cache.dirty[bank][tile / 64] |= uint64_t{1} << (tile % 64);
+  }
+}
+
+void MarkAllTilesDirty(TileCache &cache) {
+  memset(cache.dirty, 0xFF, sizeof(cache.dirty));
+}
+
+const uint8_t *DecodedTileRow(const PpuState &state, int bank, int row_addr, bool flip_x) {
+  TileCache &cache = *state.tile_cache;
+  int tile = row_addr / 16;
+  uint64_t &dirty = cache.dirty[bank][tile / 64];
+  uint64_t bit = uint64_t{1} << (tile % 64);
+  if (dirty & bit) {
+    DecodeTile(state, bank, tile);
+    dirty &= ~bit;
+  }
+  return cache.pixels[bank][tile][flip_x][(row_addr / 2) % 8];
+}
+
+}  // namespace PPU
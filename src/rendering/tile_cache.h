@@ -0,0 +1,36 @@
+//
+// Created by Brian Bonafilia on 12/20/24.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_TILE_CACHE_H_
+#define GB_EMU_SRC_RENDERING_TILE_CACHE_H_
+
+#include <cstdint>
+
+namespace PPU {
+
+struct PpuState;
+
+// Tile data at 0x8000-0x97FF holds 384 tiles per bank.
+constexpr int kTilesPerBank = 384;
+
+// Every VRAM tile decoded to one color index per pixel, for both banks and
+// both X orientations. A tile is only decoded again after it was written.
+struct TileCache {
+  // [bank][tile][flip_x][row][col]
+  uint8_t pixels[2][kTilesPerBank][2][8][8];
+  // Set bits are tiles written since they were last decoded.
+  uint64_t dirty[2][kTilesPerBank / 64];
+};
+
+// Invalidate the tiles overlapping length bytes of bank at VRAM offset addr.
+void MarkTilesDirty(TileCache& cache, int bank, int addr, int length);
+
+void MarkAllTilesDirty(TileCache& cache);
+
+// Decoded pixels of the tile row whose low byte is at VRAM offset row_addr.
+const uint8_t* DecodedTileRow(const PpuState& state, int bank, int row_addr, bool flip_x);
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_RENDERING_TILE_CACHE_H_
@@ -0,0 +1,391 @@
+//
+// Created by Brian Bonafilia on 1/2/25.
+//
+
+#include "upscale.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "../memory_arena.h"
+#include "simd.h"
+
+namespace PPU {
+
+namespace {
+
+constexpr int kWidth = Memory::kScreenWidth;
+constexpr int kHeight = Memory::kScreenHeight;
+constexpr int kNearestScale = 5;
+
+// A source line with the lines above and below it, each with its edge
+// pixels repeated once on both sides so x - 1 and x + 1 are always valid.
+struct Neighborhood {
+  uint32_t rows[3][kWidth + 2];
+
+  const uint32_t *up() const {
+    return rows[0] + 1;
+  }
+  const uint32_t *mid() const {
+    return rows[1] + 1;
+  }
+  const uint32_t *down() const {
+    return rows[2] + 1;
+  }
+};
+
+void LoadNeighborhood(const uint32_t *in, int line, Neighborhood &n) {
+  for (int i = 0; i < 3; ++i) {
+    const uint32_t *src = in + std::clamp(line + i - 1, 0, kHeight - 1) * kWidth;
+    memcpy(n.rows[i] + 1, src, kWidth * sizeof(uint32_t));
+    n.rows[i][0] = src[0];
+    n.rows[i][kWidth + 1] = src[kWidth - 1];
+  }
+}
+
+void NearestLine(const uint32_t *src, uint32_t *out, int stride) {
+  for (int x = 0; x < kWidth; ++x) {
+    std::fill_n(out + x * kNearestScale, kNearestScale, src[x]);
+  }
+  for (int row = 1; row < kNearestScale; ++row) {
+    memcpy(out + row * stride, out, kWidth * kNearestScale * sizeof(uint32_t));
+  }
+}
+
+/*
+ * Scale2x and Scale3x name the neighborhood of a pixel E
+ *   A B C
+ *   D E F
+ *   G H I
+ * and only change pixels where B != H and D != F.
+ */
+
+void Scale2xLineScalar(const Neighborhood &n, uint32_t *out, int stride) {
+  const uint32_t *up = n.up();
+  const uint32_t *mid = n.mid();
+  const uint32_t *down = n.down();
+  for (int x = 0; x < kWidth; ++x) {
+    uint32_t B = up[x], D = mid[x - 1], E = mid[x], F = mid[x + 1], H = down[x];
+    uint32_t e0 = E, e1 = E, e2 = E, e3 = E;
+    if (B != H && D != F) {
+      e0 = D == B ? D : E;
+      e1 = B == F ? F : E;
+      e2 = D == H ? D : E;
+      e3 = H == F ? F : E;
+    }
+    out[x * 2] = e0;
+    out[x * 2 + 1] = e1;
+    out[stride + x * 2] = e2;
+    out[stride + x * 2 + 1] = e3;
+  }
+}
+
+void Scale3xLineScalar(const Neighborhood &n, uint32_t *out, int stride) {
+  const uint32_t *up = n.up();
+  const uint32_t *mid = n.mid();
+  const uint32_t *down = n.down();
+  for (int x = 0; x < kWidth; ++x) {
+    uint32_t A = up[x - 1], B = up[x], C = up[x + 1];
+    uint32_t D = mid[x - 1], E = mid[x], F = mid[x + 1];
+    uint32_t G = down[x - 1], H = down[x], I = down[x + 1];
+    uint32_t e[9]{E, E, E, E, E, E, E, E, E};
+    if (B != H && D != F) {
+      e[0] = D == B ? D : E;
+      e[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+      e[2] = B == F ? F : E;
+      e[3] = (D == B && E != G) || (D == H && E != A) ? D : E;
+      e[5] = (B == F && E != I) || (H == F && E != C) ? F : E;
+      e[6] = D == H ? D : E;
+      e[7] = (D == H && E != I) || (H == F && E != G) ? H : E;
+      e[8] = H == F ? F : E;
+    }
+    for (int row = 0; row < 3; ++row) {
+      std::copy_n(e + row * 3, 3, out + row * stride + x * 3);
+    }
+  }
+}
+
+#ifdef GB_EMU_X86_KERNELS
+
+__m128i Load(const uint32_t *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+void Store(uint32_t *p, __m128i v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+// mask ? a : b per lane.
+__m128i Select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// The same rules as the scalar versions, four pixels at a time, with the
+// comparisons as lane masks.
+void Scale2xLineSse2(const Neighborhood &n, uint32_t *out, int stride) {
+  const uint32_t *up = n.up();
+  const uint32_t *mid = n.mid();
+  const uint32_t *down = n.down();
+  for (int x = 0; x < kWidth; x += 4) {
+    __m128i B = Load(up + x), D = Load(mid + x - 1), E = Load(mid + x), F = Load(mid + x + 1), H = Load(down + x);
+    __m128i unchanged = _mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F));
+    __m128i e0 = Select(_mm_andnot_si128(unchanged, _mm_cmpeq_epi32(D, B)), D, E);
+    __m128i e1 = Select(_mm_andnot_si128(unchanged, _mm_cmpeq_epi32(B, F)), F, E);
+    __m128i e2 = Select(_mm_andnot_si128(unchanged, _mm_cmpeq_epi32(D, H)), D, E);
+    __m128i e3 = Select(_mm_andnot_si128(unchanged, _mm_cmpeq_epi32(H, F)), F, E);
+    Store(out + x * 2, _mm_unpacklo_epi32(e0, e1));
+    Store(out + x * 2 + 4, _mm_unpackhi_epi32(e0, e1));
+    Store(out + stride + x * 2, _mm_unpacklo_epi32(e2, e3));
+    Store(out + stride + x * 2 + 4, _mm_unpackhi_epi32(e2, e3));
+  }
+}
+
+void Scale3xLineSse2(const Neighborhood &n, uint32_t *out, int stride) {
+  const uint32_t *up = n.up();
+  const uint32_t *mid = n.mid();
+  const uint32_t *down = n.down();
+  alignas(16) uint32_t e[9][4];
+  for (int x = 0; x < kWidth; x += 4) {
+    __m128i A = Load(up + x - 1), B = Load(up + x), C = Load(up + x + 1);
+    __m128i D = Load(mid + x - 1), E = Load(mid + x), F = Load(mid + x + 1);
+    __m128i G = Load(down + x - 1), H = Load(down + x), I = Load(down + x + 1);
+    __m128i unchanged = _mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F));
+    __m128i db = _mm_andnot_si128(unchanged, _mm_cmpeq_epi32(D, B));
+    __m128i bf = _mm_andnot_si128(unchanged, _mm_cmpeq_epi32(B, F));
+    __m128i dh = _mm_andnot_si128(unchanged, _mm_cmpeq_epi32(D, H));
+    __m128i hf = _mm_andnot_si128(unchanged, _mm_cmpeq_epi32(H, F));
+    // db && E != X, as db & ~(E == X).
+    auto unless = [&E](__m128i mask, __m128i X) {
+      return _mm_andnot_si128(_mm_cmpeq_epi32(E, X), mask);
+    };
+    Store(e[0], Select(db, D, E));
+    Store(e[1], Select(_mm_or_si128(unless(db, C), unless(bf, A)), B, E));
+    Store(e[2], Select(bf, F, E));
+    Store(e[3], Select(_mm_or_si128(unless(db, G), unless(dh, A)), D, E));
+    Store(e[4], E);
+    Store(e[5], Select(_mm_or_si128(unless(bf, I), unless(hf, C)), F, E));
+    Store(e[6], Select(dh, D, E));
+    Store(e[7], Select(_mm_or_si128(unless(dh, I), unless(hf, G)), H, E));
+    Store(e[8], Select(hf, F, E));
+    for (int lane = 0; lane < 4; ++lane) {
+      for (int row = 0; row < 3; ++row) {
+        uint32_t *dest = out + row * stride + (x + lane) * 3;
+        dest[0] = e[row * 3][lane];
+        dest[1] = e[row * 3 + 1][lane];
+        dest[2] = e[row * 3 + 2][lane];
+      }
+    }
+  }
+}
+
+#endif
+
+/* xBR-lite */
+
+struct Yuv {
+  int y, u, v;
+};
+
+Yuv ToYuv(uint32_t color) {
+  int r = (color >> 16) & 0xFF;
+  int g = (color >> 8) & 0xFF;
+  int b = color & 0xFF;
+  int y = (r * 77 + g * 150 + b * 29) >> 8;
+  return {y, ((b - y) * 144) >> 8, ((r - y) * 183) >> 8};
+}
+
+// xBR's color distance, luma weighs the most.
+int Distance(const Yuv &a, const Yuv &b) {
+  return 48 * std::abs(a.y - b.y) + 7 * std::abs(a.u - b.u) + 6 * std::abs(a.v - b.v);
+}
+
+uint32_t Blend(uint32_t a, uint32_t b) {
+  return (a & b) + (((a ^ b) & 0xFEFEFE) >> 1);
+}
+
+// The distances the corner rules need for the pixel E in the middle of a
+// 3x3 block: from E to every neighbor, and between each horizontal neighbor
+// and each vertical one.
+struct XbrDistances {
+  int from_center[3][3];
+  // [horizontal neighbor on the right][vertical neighbor below]
+  int sides[2][2];
+};
+
+// Corner (sx, sy) of E. It is blended when the edge through its two side
+// neighbors is a better match than the one through E and its diagonal
+// neighbor, with F and H the side neighbors and I the diagonal one.
+uint32_t XbrCorner(const uint32_t (&c)[3][3], const XbrDistances &d, int sx, int sy) {
+  int right = sx > 0, below = sy > 0;
+  int along = d.from_center[1 - sy][1 + sx] + d.from_center[1 + sy][1 - sx] + 4 * d.sides[right][below];
+  int across = d.sides[right][!below] + d.sides[!right][below] + 4 * d.from_center[1 + sy][1 + sx];
+  if (along >= across) {
+    return c[1][1];
+  }
+  uint32_t nearer = d.from_center[1][1 + sx] <= d.from_center[1 + sy][1] ? c[1][1 + sx] : c[1 + sy][1];
+  return Blend(c[1][1], nearer);
+}
+
+void XbrLiteLine(const Neighborhood &n, uint32_t *out, int stride) {
+  Yuv yuv[3][kWidth + 2];
+  for (int row = 0; row < 3; ++row) {
+    for (int x = 0; x < kWidth + 2; ++x) {
+      yuv[row][x] = ToYuv(n.rows[row][x]);
+    }
+  }
+  for (int x = 0; x < kWidth; ++x) {
+    uint32_t c[3][3];
+    XbrDistances d;
+    const Yuv &E = yuv[1][x + 1];
+    for (int row = 0; row < 3; ++row) {
+      for (int col = 0; col < 3; ++col) {
+        c[row][col] = n.rows[row][x + col];
+        d.from_center[row][col] = Distance(E, yuv[row][x + col]);
+      }
+    }
+    for (int right = 0; right < 2; ++right) {
+      for (int below = 0; below < 2; ++below) {
+        d.sides[right][below] = Distance(yuv[1][x + right * 2], yuv[below * 2][x + 1]);
+      }
+    }
+    out[x * 2] = XbrCorner(c, d, -1, -1);
+    out[x * 2 + 1] = XbrCorner(c, d, 1, -1);
+    out[stride + x * 2] = XbrCorner(c, d, -1, 1);
+    out[stride + x * 2 + 1] = XbrCorner(c, d, 1, 1);
+  }
+}
+
+}  // namespace
+
+int ScaleFactor(ScaleFilter filter) {
+  switch (filter) {
+    case nearest_filter:
+      return kNearestScale;
+    case scale3x_filter:
+      return 3;
+    case scale2x_filter:
+    case xbr_lite_filter:
+      return 2;
+  }
+  return 1;
+}
+
+const char *FilterName(ScaleFilter filter) {
+  switch (filter) {
+    case nearest_filter:
+      return "nearest";
+    case scale2x_filter:
+      return "scale2x";
+    case scale3x_filter:
+      return "scale3x";
+    case xbr_lite_filter:
+      return "xbr-lite";
+  }
+  return "";
+}
+
+void ScaleLines(ScaleFilter filter, SimdLevel level, const uint32_t *in, int first, int last, uint32_t *out,
+                int stride) {
+  int scale = ScaleFactor(filter);
+  Neighborhood n;
+  for (int line = first; line < last; ++line) {
+    uint32_t *dest = out + line * scale * stride;
+    if (filter == nearest_filter) {
+      NearestLine(in + line * kWidth, dest, stride);
+      continue;
+    }
+    LoadNeighborhood(in, line, n);
+    bool simd = false;
+#ifdef GB_EMU_X86_KERNELS
+    simd = level != scalar_kernels;
+#endif
+    switch (filter) {
+      case scale2x_filter:
+#ifdef GB_EMU_X86_KERNELS
+        if (simd) {
+          Scale2xLineSse2(n, dest, stride);
+          break;
+        }
+#endif
+        Scale2xLineScalar(n, dest, stride);
+        break;
+      case scale3x_filter:
+#ifdef GB_EMU_X86_KERNELS
+        if (simd) {
+          Scale3xLineSse2(n, dest, stride);
+          break;
+        }
+#endif
+        Scale3xLineScalar(n, dest, stride);
+        break;
+      case xbr_lite_filter:
+        XbrLiteLine(n, dest, stride);
+        break;
+      case nearest_filter:
+        break;
+    }
+  }
+}
+
+Upscaler::Upscaler(ScaleFilter filter, int threads)
+    : filter_(filter), level_(DetectSimdLevel()), bands_(std::clamp(threads, 1, kHeight)) {
+  for (int band = 1; band < bands_; ++band) {
+    workers_.emplace_back(&Upscaler::Work, this, band);
+  }
+}
+
+Upscaler::~Upscaler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void Upscaler::Scale(const uint32_t *in, uint32_t *out, int stride) {
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_ = in;
+    out_ = out;
+    stride_ = stride;
+    pending_ = bands_ - 1;
+    ++generation_;
+  }
+  start_.notify_all();
+  ScaleBand(0);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+  }
+  last_frame_us_ = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Upscaler::ScaleBand(int band) {
+  ScaleLines(filter_, level_, in_, band * kHeight / bands_, (band + 1) * kHeight / bands_, out_, stride_);
+}
+
+void Upscaler::Work(int band) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+    }
+    ScaleBand(band);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+}  // namespace PPU
@@ -0,0 +1,84 @@
+//
+// Created by Brian Bonafilia on 1/2/25.
+//
+
+#ifndef GB_EMU_SRC_RENDERING_UPSCALE_H_
+#define GB_EMU_SRC_RENDERING_UPSCALE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "pixel_kernels.h"
+
+// CPU upscaling of finished 160x144 RGB888 frames, for frontends that should
+// not rely on the GPU to stretch the picture.
+namespace PPU {
+
+enum ScaleFilter {
+  // Every pixel repeated 5x5, which exactly fills the 800x720 window.
+  nearest_filter,
+  // EPX/AdvMAME2x, rounds off diagonal staircases without new colors.
+  scale2x_filter,
+  // AdvMAME3x, the same rules with a 3x3 block per pixel.
+  scale3x_filter,
+  // 2x, a reduced xBR: corners along a detected edge are blended with the
+  // neighbor closest in YUV. Only looks at the 3x3 neighborhood.
+  xbr_lite_filter
+};
+
+// Output pixels per source pixel along each axis.
+int ScaleFactor(ScaleFilter filter);
+
+const char* FilterName(ScaleFilter filter);
+
+// Scale source lines [first, last) of a frame into their rows of the scaled
+// frame out, which has stride pixels per row. Reads the lines around the
+// range too, so bands of a frame can be scaled independently.
+void ScaleLines(ScaleFilter filter, SimdLevel level, const uint32_t* in, int first, int last, uint32_t* out,
+                int stride);
+
+// Scales whole frames, split into bands of lines over a set of threads. The
+// calling thread does the first band itself and waits for the rest.
+class Upscaler {
+ public:
+  // threads counts the calling thread, 1 scales everything on it.
+  Upscaler(ScaleFilter filter, int threads);
+  ~Upscaler();
+
+  void Scale(const uint32_t* in, uint32_t* out, int stride);
+
+  ScaleFilter filter() const {
+    return filter_;
+  }
+
+  // Wall time of the last Scale call.
+  double last_frame_us() const {
+    return last_frame_us_;
+  }
+
+ private:
+  void ScaleBand(int band);
+  void Work(int band);
+
+  const ScaleFilter filter_;
+  const SimdLevel level_;
+  const int bands_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  // Bumped for every frame, workers start a band when it changes.
+  uint64_t generation_ = 0;
+  int pending_ = 0;
+  bool stopping_ = false;
+  const uint32_t* in_ = nullptr;
+  uint32_t* out_ = nullptr;
+  int stride_ = 0;
+  double last_frame_us_ = 0;
+};
+
+}  // namespace PPU
+
+#endif //GB_EMU_SRC_RENDERING_UPSCALE_H_
@@ -0,0 +1,85 @@
+//
+// Created by Brian Bonafilia on 1/2/25.
+//
+
+#include "upscale.h"
+
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace PPU {
+namespace {
+
+constexpr int kWidth = 160;
+constexpr int kHeight = 144;
+constexpr ScaleFilter kFilters[]{nearest_filter, scale2x_filter, scale3x_filter, xbr_lite_filter};
+
+// Few colors so neighbors are often equal and every rule gets taken.
+std::vector<uint32_t> RandomFrame() {
+  constexpr uint32_t kColors[]{0xFFFFFF, 0xAAAAAA, 0x555555, 0x000000};
+  std::vector<uint32_t> frame(kWidth * kHeight);
+  uint32_t seed = 1;
+  for (uint32_t &pixel : frame) {
+    seed = seed * 1103515245 + 12345;
+    pixel = kColors[(seed >> 16) & 3];
+  }
+  return frame;
+}
+
+std::vector<uint32_t> ScaleAll(ScaleFilter filter, SimdLevel level, const std::vector<uint32_t> &in) {
+  int scale = ScaleFactor(filter);
+  std::vector<uint32_t> out(kWidth * scale * kHeight * scale);
+  ScaleLines(filter, level, in.data(), 0, kHeight, out.data(), kWidth * scale);
+  return out;
+}
+
+TEST(Upscale, FlatFrameStaysFlat) {
+  std::vector<uint32_t> in(kWidth * kHeight, 0x123456);
+  for (ScaleFilter filter : kFilters) {
+    for (uint32_t pixel : ScaleAll(filter, scalar_kernels, in)) {
+      ASSERT_EQ(pixel, 0x123456u) << FilterName(filter);
+    }
+  }
+}
+
+TEST(Upscale, Scale2xRoundsDiagonal) {
+  // A black pixel above and left of E, white elsewhere: only E's top left
+  // sub-pixel turns black.
+  std::vector<uint32_t> in(kWidth * kHeight, 0xFFFFFF);
+  in[10 * kWidth + 11] = 0;
+  in[11 * kWidth + 10] = 0;
+  std::vector<uint32_t> out = ScaleAll(scale2x_filter, scalar_kernels, in);
+  int stride = kWidth * 2;
+  EXPECT_EQ(out[22 * stride + 22], 0u);
+  EXPECT_EQ(out[22 * stride + 23], 0xFFFFFFu);
+  EXPECT_EQ(out[23 * stride + 22], 0xFFFFFFu);
+  EXPECT_EQ(out[23 * stride + 23], 0xFFFFFFu);
+}
+
+TEST(Upscale, SimdMatchesScalar) {
+  if (DetectSimdLevel() == scalar_kernels) {
+    GTEST_SKIP() << "no SIMD kernels on this CPU";
+  }
+  std::vector<uint32_t> in = RandomFrame();
+  for (ScaleFilter filter : kFilters) {
+    EXPECT_EQ(ScaleAll(filter, scalar_kernels, in), ScaleAll(filter, DetectSimdLevel(), in)) << FilterName(filter);
+  }
+}
+
+TEST(Upscale, BandsMatchSingleThread) {
+  std::vector<uint32_t> in = RandomFrame();
+  for (ScaleFilter filter : kFilters) {
+    int scale = ScaleFactor(filter);
+    std::vector<uint32_t> single(kWidth * scale * kHeight * scale);
+    std::vector<uint32_t> banded(single.size());
+    Upscaler(filter, 1).Scale(in.data(), single.data(), kWidth * scale);
+    Upscaler upscaler(filter, 5);
+    // twice, so the workers also pick up a second frame.
+    upscaler.Scale(in.data(), banded.data(), kWidth * scale);
+    upscaler.Scale(in.data(), banded.data(), kWidth * scale);
+    EXPECT_EQ(single, banded) << FilterName(filter);
+  }
+}
+
+}  // namespace
+}  // namespace PPU
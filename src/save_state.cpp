@@ -0,0 +1,31 @@
+//
+// Created by Brian Bonafilia on 1/9/25.
+//
+
+#include "save_state.h"
+
+#include <cstring>
+
+namespace Memory {
+
+void SaveState(State* out) {
+  memcpy(&out->arena, &arena, sizeof(Arena));
+  CPU::SaveState(&out->cpu, &out->cpu_internals);
+  PPU::SaveState(&out->ppu);
+  APU::SaveState(&out->apu);
+  out->mapper = Cartridge::SaveMapper();
+}
+
+void LoadState(const State& in) {
+  // Before the arena, the APU plays up to now from the wave RAM it had.
+  APU::LoadState(in.apu);
+  memcpy(&arena, &in.arena, sizeof(Arena));
+  CPU::LoadState(in.cpu, in.cpu_internals);
+  // After the arena, the PPU redecodes its caches from it.
+  PPU::LoadState(in.ppu);
+  if (in.mapper) {
+    Cartridge::LoadMapper(*in.mapper);
+  }
+}
+
+}  // namespace Memory
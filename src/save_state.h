@@ -0,0 +1,35 @@
+//
+// Created by Brian Bonafilia on 1/9/25.
+//
+
+#ifndef GB_EMU_SRC_SAVE_STATE_H_
+#define GB_EMU_SRC_SAVE_STATE_H_
+
+#include <optional>
+#include "apu.h"
+#include "cartridge.h"
+#include "cpu.h"
+#include "memory_arena.h"
+#include "ppu.h"
+
+namespace Memory {
+
+// Everything needed to resume emulation: guest memory plus the registers of
+// the CPU, PPU, APU and mapper that live next to it. Take and restore states
+// between frames.
+struct State {
+  Arena arena;
+  CPU::Registers cpu;
+  CPU::Internals cpu_internals;
+  PPU::Registers ppu;
+  APU::State apu;
+  std::optional<Cartridge::MapperVariant> mapper;
+};
+
+void SaveState(State* out);
+// Restore a state saved with the cartridge that is loaded now.
+void LoadState(const State& in);
+
+}  // namespace Memory
+
+#endif //GB_EMU_SRC_SAVE_STATE_H_
@@ -0,0 +1,107 @@
+//
+// Created by Brian Bonafilia on 1/9/25.
+//
+
+#include "save_state.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace Memory {
+namespace {
+
+// An MBC1 ROM of 4 banks, each starting with its own bank number.
+void WriteBankedRom(const char* path) {
+  std::vector<uint8_t> rom(4 * 0x4000);
+  for (int bank = 0; bank < 4; ++bank) {
+    rom[bank * 0x4000] = bank;
+  }
+  rom[0x147] = 0x01;
+  rom[0x148] = 0x01;
+  uint8_t checksum = 0;
+  for (int i = 0x134; i <= 0x14C; ++i) {
+    checksum = checksum - rom[i] - 1;
+  }
+  rom[0x14D] = checksum;
+  FILE* file = fopen(path, "wb");
+  fwrite(rom.data(), 1, rom.size(), file);
+  fclose(file);
+}
+
+uint8_t Read(uint16_t addr) {
+  return CPU::access<CPU::read>(addr);
+}
+
+void Write(uint16_t addr, uint8_t val) {
+  CPU::access<CPU::write>(addr, val);
+}
+
+TEST(SaveState, LoadUndoesEverythingSinceTheSave) {
+  const char* rom_path = "save_state_test.gb";
+  WriteBankedRom(rom_path);
+  // the ROM is read into memory, the file is not needed after loading.
+  bool loaded = Cartridge::load_cartridge(rom_path);
+  std::remove(rom_path);
+  ASSERT_TRUE(loaded);
+  CPU::InitializeRegisters(true);
+  // With the LCD off VRAM is accessible at any time.
+  Write(0xFF40, 0x00);
+
+  Write(0x2000, 2);
+  Write(0xFF70, 3);
+  Write(0xD000, 0x33);
+  Write(0xFF4F, 1);
+  Write(0x8000, 0x44);
+  // HBlank DMA of 4 blocks, waiting for the LCD to come back on.
+  Write(0xFF51, 0xC0);
+  Write(0xFF52, 0x00);
+  Write(0xFF53, 0x00);
+  Write(0xFF54, 0x00);
+  Write(0xFF55, 0x83);
+  CPU::GetRegisters().A = 0x12;
+  ASSERT_EQ(Read(0xFF55), 0x03);
+  // Channel 2 playing at full volume.
+  Write(0xFF24, 0x35);
+  Write(0xFF17, 0xF0);
+  Write(0xFF19, 0x80);
+  uint8_t sound_status = Read(0xFF26);
+  ASSERT_EQ(sound_status & 0x82, 0x82);
+
+  auto state = std::make_unique<State>();
+  SaveState(state.get());
+
+  Write(0x2000, 3);
+  Write(0xD000, 0x77);
+  Write(0xFF70, 1);
+  Write(0xD000, 0x99);
+  Write(0x8000, 0x55);
+  Write(0xFF4F, 0);
+  Write(0x8000, 0x66);
+  Write(0xFF55, 0x00);
+  CPU::GetRegisters().A = 0;
+  // Powering the APU off clears every register and channel.
+  Write(0xFF26, 0x00);
+  ASSERT_EQ(Read(0x4000), 3);
+  ASSERT_NE(Read(0xFF55), 0x03);
+
+  LoadState(*state);
+  EXPECT_EQ(CPU::GetRegisters().A, 0x12);
+  EXPECT_EQ(Read(0x4000), 2);
+  // The banks mapped at 0xD000 and 0x8000 follow the restored registers.
+  EXPECT_EQ(Read(0xD000), 0x33);
+  EXPECT_EQ(Read(0x8000), 0x44);
+  EXPECT_EQ(Read(0xFF55), 0x03);
+  EXPECT_EQ(Read(0xFF24), 0x35);
+  EXPECT_EQ(Read(0xFF26), sound_status);
+
+  // Memory outside the selected banks is restored as well.
+  Write(0xFF70, 1);
+  EXPECT_EQ(Read(0xD000), 0x00);
+  Write(0xFF4F, 0);
+  EXPECT_EQ(Read(0x8000), 0x00);
+}
+
+}  // namespace
+}  // namespace Memory
@@ -0,0 +1,101 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#ifndef GB_EMU_SRC_SPSC_QUEUE_H_
+#define GB_EMU_SRC_SPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. kCapacity must be a power of two.
+template <typename T, size_t kCapacity>
+class SpscQueue {
+  static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+ public:
+  // Returns false without blocking when the queue is full.
+  bool TryPush(const T& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == kCapacity) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == kCapacity) {
+        return false;
+      }
+    }
+    slots_[tail & kMask] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false without blocking when the queue is empty.
+  bool TryPop(T& out) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return false;
+      }
+    }
+    out = slots_[head & kMask];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Copy up to count values from in, one pair of atomics for the whole run.
+  // Returns how many fit, never blocks.
+  size_t PushSome(const T* in, size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (kCapacity - (tail - head_cache_) < count) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+    }
+    count = std::min(count, kCapacity - (tail - head_cache_));
+    size_t start = tail & kMask;
+    size_t first = std::min(count, kCapacity - start);
+    std::copy(in, in + first, slots_ + start);
+    std::copy(in + first, in + count, slots_);
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  // Move up to count values to out, returns how many there were. Never
+  // blocks.
+  size_t PopSome(T* out, size_t count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < count) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+    count = std::min(count, tail_cache_ - head);
+    size_t start = head & kMask;
+    size_t first = std::min(count, kCapacity - start);
+    std::copy(slots_ + start, slots_ + start + first, out);
+    std::copy(slots_, slots_ + (count - first), out + first);
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  // Number of queued values, exact only from the producer or the consumer
+  // while the other side is idle.
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t Capacity() {
+    return kCapacity;
+  }
+
+ private:
+  static constexpr size_t kMask = kCapacity - 1;
+
+  // Consumer side.
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+  // Producer side.
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+  alignas(64) T slots_[kCapacity];
+};
+
+#endif //GB_EMU_SRC_SPSC_QUEUE_H_
@@ -0,0 +1,70 @@
+//
+// Created by Brian Bonafilia on 12/28/24.
+//
+
+#include "spsc_queue.h"
+
+#include <algorithm>
+#include <thread>
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(SpscQueue, FifoUntilFull) {
+  SpscQueue<int, 4> queue;
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(value));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+  EXPECT_FALSE(queue.TryPush(4));
+  EXPECT_EQ(queue.Size(), 4);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.TryPop(value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(queue.TryPop(value));
+  EXPECT_TRUE(queue.TryPush(5));
+  ASSERT_TRUE(queue.TryPop(value));
+  EXPECT_EQ(value, 5);
+}
+
+TEST(SpscQueue, ConcurrentInOrder) {
+  constexpr int kValues = 100'000;
+  SpscQueue<int, 256> queue;
+  std::thread producer([&queue] {
+    for (int i = 0; i < kValues; ++i) {
+      while (!queue.TryPush(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (int expected = 0; expected < kValues;) {
+    int value;
+    if (queue.TryPop(value)) {
+      ASSERT_EQ(value, expected);
+      ++expected;
+    } else {
+      // let the producer run when both share a core.
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+}
+
+TEST(SpscQueue, BulkWrapsAround) {
+  SpscQueue<int, 8> queue;
+  const int values[]{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  int out[12]{};
+  EXPECT_EQ(queue.PushSome(values, 6), 6u);
+  EXPECT_EQ(queue.PopSome(out, 4), 4u);
+  // both runs wrap around the end of the slots.
+  EXPECT_EQ(queue.PushSome(values + 6, 4), 4u);
+  EXPECT_EQ(queue.PushSome(values, 4), 2u);
+  EXPECT_EQ(queue.PopSome(out + 4, 10), 8u);
+  const int expected[]{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1};
+  EXPECT_TRUE(std::equal(out, out + 12, expected));
+  EXPECT_EQ(queue.PopSome(out, 1), 0u);
+}
+
+}
@@ -0,0 +1,104 @@
+//
+// Created by Brian Bonafilia on 1/4/25.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../cartridge.h"
+#include "../cpu.h"
+#include "../ppu.h"
+#include "../debug/golden.h"
+
+// Headless golden image check of one ROM and input movie:
+//   golden_runner [--movie=<file>] [--frames=<n>] [--ppm=<file>] [--update]
+//                 [--scanline | --pipelined | --spans] <golden file> <rom>
+// Exits with 1 when a frame hash differs from the golden list, or when fewer
+// frames were drawn. --update rewrites the golden list from this run instead.
+namespace {
+
+constexpr char kMovieFlag[] = "--movie=";
+constexpr char kFramesFlag[] = "--frames=";
+constexpr char kPpmFlag[] = "--ppm=";
+constexpr char kUpdateFlag[] = "--update";
+constexpr char kScanlineFlag[] = "--scanline";
+constexpr char kPipelinedFlag[] = "--pipelined";
+constexpr char kSpansFlag[] = "--spans";
+constexpr int kDefaultFrames = 600;
+
+bool HasPrefix(const std::string &arg, const char *prefix) {
+  return arg.rfind(prefix, 0) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string movie_path;
+  std::string ppm_path = "divergence.ppm";
+  int frames = kDefaultFrames;
+  bool update = false;
+  for (int i = 1; i < argc - 2; ++i) {
+    std::string arg = argv[i];
+    if (HasPrefix(arg, kMovieFlag)) {
+      movie_path = arg.substr(strlen(kMovieFlag));
+    } else if (HasPrefix(arg, kFramesFlag)) {
+      frames = std::stoi(arg.substr(strlen(kFramesFlag)));
+    } else if (HasPrefix(arg, kPpmFlag)) {
+      ppm_path = arg.substr(strlen(kPpmFlag));
+    } else if (arg == kUpdateFlag) {
+      update = true;
+    } else if (arg == kScanlineFlag) {
+      PPU::set_render_mode(PPU::scanline_renderer);
+    } else if (arg == kPipelinedFlag) {
+      PPU::set_render_mode(PPU::pipelined_renderer);
+    } else if (arg == kSpansFlag) {
+      PPU::set_render_mode(PPU::span_renderer);
+    } else {
+      fprintf(stderr, "unknown flag %s\n", arg.c_str());
+      return 2;
+    }
+  }
+  if (argc < 3) {
+    fprintf(stderr, "usage: golden_runner [flags] <golden file> <rom>\n");
+    return 2;
+  }
+  const char *golden_path = argv[argc - 2];
+
+  Debug::Movie movie;
+  if (!movie_path.empty() && !Debug::LoadMovie(movie_path.c_str(), movie)) {
+    return 2;
+  }
+  std::vector<uint64_t> golden;
+  if (!update && !Debug::LoadGolden(golden_path, golden)) {
+    fprintf(stderr, "failed to read golden list %s, run with --update to create it\n", golden_path);
+    return 2;
+  }
+  if (!Cartridge::load_cartridge(argv[argc - 1])) {
+    return 2;
+  }
+  CPU::InitializeRegisters(Cartridge::IsCgbMode());
+
+  if (update) {
+    Debug::GoldenResult result = Debug::RunGolden(movie, frames, nullptr, nullptr);
+    if (!Debug::SaveGolden(golden_path, result.hashes)) {
+      fprintf(stderr, "failed to write %s\n", golden_path);
+      return 2;
+    }
+    printf("wrote %zu frame hashes to %s\n", result.hashes.size(), golden_path);
+    return 0;
+  }
+
+  frames = std::min<int>(frames, golden.size());
+  Debug::GoldenResult result = Debug::RunGolden(movie, frames, &golden, ppm_path.c_str());
+  if (result.first_divergence >= 0) {
+    return 1;
+  }
+  if (result.hashes.size() < static_cast<size_t>(frames)) {
+    printf("only %zu of %d frames were drawn\n", result.hashes.size(), frames);
+    return 1;
+  }
+  printf("all %d frames match\n", frames);
+  return 0;
+}
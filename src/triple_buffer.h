@@ -0,0 +1,54 @@
+//
+// Created by Brian Bonafilia on 12/26/24.
+//
+
+#ifndef GB_EMU_SRC_TRIPLE_BUFFER_H_
+#define GB_EMU_SRC_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the newest value from one producer thread to one
+// consumer thread. The producer fills the back slot and publishes it, the
+// consumer takes the newest published slot. Neither side ever waits; frames
+// the consumer was too slow to pick up are replaced.
+template <typename T>
+class TripleBuffer {
+ public:
+  // Slot the producer fills next, only touched by the producer.
+  T& back() {
+    return slots_[back_];
+  }
+
+  // Swap the filled back slot with the one in the middle and flag it new.
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Take the newest published slot into front(). Returns false when nothing
+  // was published since the last call.
+  bool Consume() {
+    if (!(middle_.load(std::memory_order_relaxed) & kFresh)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  // Slot the consumer reads, only touched by the consumer.
+  const T& front() const {
+    return slots_[front_];
+  }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  T slots_[3]{};
+  uint8_t back_ = 0;
+  uint8_t front_ = 1;
+  // index of the middle slot, with kFresh set while it holds an unread value.
+  std::atomic<uint8_t> middle_{2};
+};
+
+#endif //GB_EMU_SRC_TRIPLE_BUFFER_H_
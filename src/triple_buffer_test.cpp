@@ -0,0 +1,63 @@
+//
+// Created by Brian Bonafilia on 12/26/24.
+//
+
+#include "triple_buffer.h"
+
+#include <thread>
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(TripleBuffer, NothingPublished) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.Consume());
+}
+
+TEST(TripleBuffer, ConsumesNewest) {
+  TripleBuffer<int> buffer;
+  buffer.back() = 1;
+  buffer.Publish();
+  buffer.back() = 2;
+  buffer.Publish();
+  ASSERT_TRUE(buffer.Consume());
+  EXPECT_EQ(buffer.front(), 2);
+  EXPECT_FALSE(buffer.Consume());
+  EXPECT_EQ(buffer.front(), 2);
+
+  buffer.back() = 3;
+  buffer.Publish();
+  ASSERT_TRUE(buffer.Consume());
+  EXPECT_EQ(buffer.front(), 3);
+}
+
+TEST(TripleBuffer, ConsumerNeverSeesTornFrames) {
+  struct Frame {
+    int values[64];
+  };
+  constexpr int kFrames = 100000;
+  TripleBuffer<Frame> buffer;
+  std::thread producer([&buffer] {
+    for (int frame = 1; frame <= kFrames; ++frame) {
+      for (int &value : buffer.back().values) {
+        value = frame;
+      }
+      buffer.Publish();
+    }
+  });
+  int last = 0;
+  while (last < kFrames) {
+    if (!buffer.Consume()) {
+      continue;
+    }
+    const Frame &frame = buffer.front();
+    ASSERT_GT(frame.values[0], last);
+    for (int value : frame.values) {
+      ASSERT_EQ(value, frame.values[0]);
+    }
+    last = frame.values[0];
+  }
+  producer.join();
+}
+
+}